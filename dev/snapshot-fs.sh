@@ -0,0 +1,113 @@
+#!/usr/bin/env bash
+# Records the /proc and /sys files the CPU and AMD plugins read into a directory. Plugins read
+# from it instead of the real files when it's set as TUXCLOCKER_FS_ROOT, eg.
+#
+#	./snapshot-fs.sh --cpus 256 --gpus 16 ~/fixtures/big
+#	TUXCLOCKER_FS_ROOT=~/fixtures/big tuxclockerd --session-bus --probe-cache ""
+#
+# --cpus and --gpus duplicate the first recorded core and GPU to get a bigger layout than the
+# machine has. Run as root to also record files only root can read. Values written by
+# assignables go to the recorded files.
+
+set -u
+
+cpus=0
+gpus=0
+while [ $# -gt 1 ]; do
+	case $1 in
+		--cpus) cpus=$2; shift 2 ;;
+		--gpus) gpus=$2; shift 2 ;;
+		*) break ;;
+	esac
+done
+
+if [ $# -ne 1 ]; then
+	echo "Usage: $0 [--cpus <count>] [--gpus <count>] <output directory>"
+	exit 1
+fi
+out=$1
+
+# Copies the regular files of a directory, sysfs attributes that can't be read are skipped
+copyFiles() {
+	local src=$1 dest=$out$2
+	[ -d "$src" ] || return
+	mkdir -p "$dest"
+	for file in "$src"/*; do
+		[ -f "$file" ] && [ -r "$file" ] || continue
+		local name=$(basename "$file")
+		timeout 1 cat "$file" > "$dest/$name" 2> /dev/null || rm -f "$dest/$name"
+	done
+}
+
+mkdir -p "$out/proc"
+cp /proc/cpuinfo /proc/stat "$out/proc/"
+
+for dir in /sys/devices/system/cpu/cpu[0-9]*; do
+	name=$(basename "$dir")
+	copyFiles "$dir/cpufreq" "/sys/devices/system/cpu/$name/cpufreq"
+	copyFiles "$dir/power" "/sys/devices/system/cpu/$name/power"
+done
+
+# These are symlinks to the devices, record them as directories
+for dir in /sys/class/hwmon/*; do
+	copyFiles "$dir" "/sys/class/hwmon/$(basename "$dir")"
+done
+
+for dir in /sys/class/drm/renderD*; do
+	[ -e "$dir" ] || continue
+	dest=/sys/class/drm/$(basename "$dir")/device
+	copyFiles "$dir/device" "$dest"
+	for hwmon in "$dir"/device/hwmon/hwmon*; do
+		copyFiles "$hwmon" "$dest/hwmon/$(basename "$hwmon")"
+	done
+	# Fan curve and other settings of RX 7000 and newer
+	if [ -d "$dir/device/gpu_od" ]; then
+		(cd "$dir/device" && find -L gpu_od -type d) | while read -r subdir; do
+			copyFiles "$dir/device/$subdir" "$dest/$subdir"
+		done
+	fi
+done
+
+if [ "$cpus" -gt 0 ]; then
+	# One CPU with 'cpus' threads, all like the first one
+	awk -v n="$cpus" 'BEGIN { RS = ""; ORS = "\n\n" } NR == 1 {
+		for (i = 0; i < n; i++) {
+			section = $0
+			sub(/processor\t: [0-9]+/, "processor\t: " i, section)
+			print section
+		}
+	}' /proc/cpuinfo > "$out/proc/cpuinfo"
+	awk -v n="$cpus" '/^cpu0 / {
+		for (i = 0; i < n; i++) {
+			line = $0
+			sub(/^cpu0/, "cpu" i, line)
+			print line
+		}
+		next
+	}
+	/^cpu[0-9]/ { next }
+	{ print }' /proc/stat > "$out/proc/stat"
+
+	cpuDir=$out/sys/devices/system/cpu
+	for dir in "$cpuDir"/cpu[0-9]*; do
+		[ "$(basename "$dir")" = cpu0 ] || rm -rf "$dir"
+	done
+	for ((i = 1; i < cpus; i++)); do
+		cp -r "$cpuDir/cpu0" "$cpuDir/cpu$i"
+	done
+fi
+
+if [ "$gpus" -gt 0 ]; then
+	drmDir=$out/sys/class/drm
+	first=$(ls "$drmDir" 2> /dev/null | sort | head -n 1)
+	if [ -z "$first" ]; then
+		echo "No GPUs recorded to duplicate"
+		exit 1
+	fi
+	for dir in "$drmDir"/renderD*; do
+		[ "$(basename "$dir")" = "$first" ] || rm -rf "$dir"
+	done
+	for ((i = 1; i < gpus; i++)); do
+		cp -r "$drmDir/$first" "$drmDir/renderD$((${first#renderD} + i))"
+	done
+fi
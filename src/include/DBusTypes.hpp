@@ -5,6 +5,8 @@
 #include <QDBusArgument>
 #include <QDBusVariant>
 #include <QDBusMetaType>
+#include <QPointF>
+#include <QStringList>
 #include <QVector>
 
 namespace TC = TuxClocker;
@@ -107,6 +109,171 @@ struct DeviceNode {
 	}
 };
 
+// Value of a DynamicReadable in batched calls
+struct BatchValue {
+	bool error;
+	// Index of the type in TuxClocker::Device::ReadableValue, ie. 0: int, 1: uint, 2: double
+	uchar type;
+	// Error code if 'error' is set. Integer values are exactly representable as double
+	double value;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const BatchValue v) {
+		arg.beginStructure();
+		arg << v.error << v.type << v.value;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, BatchValue &v) {
+		arg.beginStructure();
+		arg >> v.error >> v.type >> v.value;
+		arg.endStructure();
+		return arg;
+	}
+	TC::Device::ReadResult toReadResult() const {
+		if (error)
+			return static_cast<TC::Device::ReadError>(value);
+		switch (type) {
+		case 0:
+			return static_cast<int>(value);
+		case 1:
+			return static_cast<uint>(value);
+		case 2:
+			return value;
+		default:
+			return TC::Device::ReadError::UnknownError;
+		}
+	}
+};
+
+// Sample of a DynamicReadable with when it was read, see TuxClocker::SampleRecord
+struct TimedValue {
+	// Nanoseconds on the daemon's monotonic clock, zero if never sampled
+	qulonglong timestamp;
+	// Changes with every sample, also when the value doesn't
+	uint sequence;
+	bool error;
+	// Same as in BatchValue
+	uchar type;
+	double value;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const TimedValue v) {
+		arg.beginStructure();
+		arg << v.timestamp << v.sequence << v.error << v.type << v.value;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, TimedValue &v) {
+		arg.beginStructure();
+		arg >> v.timestamp >> v.sequence >> v.error >> v.type >> v.value;
+		arg.endStructure();
+		return arg;
+	}
+};
+
+// Values of multiple DynamicReadables read at the same time
+struct ValueBatch {
+	// Nanoseconds on the daemon's monotonic clock
+	qulonglong timestamp;
+	QStringList paths;
+	// Same order as 'paths'
+	QVector<BatchValue> values;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const ValueBatch b) {
+		arg.beginStructure();
+		arg << b.timestamp << b.paths << b.values;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, ValueBatch &b) {
+		arg.beginStructure();
+		arg >> b.timestamp >> b.paths >> b.values;
+		arg.endStructure();
+		return arg;
+	}
+};
+
+// Value to assign to the Assignable at 'path' in batched assignments
+struct BatchAssignment {
+	QString path;
+	// Same as the argument of 'assign'
+	QDBusVariant value;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const BatchAssignment a) {
+		arg.beginStructure();
+		arg << a.path << a.value;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, BatchAssignment &a) {
+		arg.beginStructure();
+		arg >> a.path >> a.value;
+		arg.endStructure();
+		return arg;
+	}
+};
+
+// Assignable set to the value of a DynamicReadable mapped through a piecewise linear function
+struct ReadableConnection {
+	QString targetPath;
+	QString sourcePath;
+	// x: value of the DynamicReadable, y: value of the Assignable
+	QVector<QPointF> points;
+	// How often the DynamicReadable is sampled in milliseconds, zero meaning the default
+	uint interval;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const ReadableConnection c) {
+		arg.beginStructure();
+		arg << c.targetPath << c.sourcePath << c.points << c.interval;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, ReadableConnection &c) {
+		arg.beginStructure();
+		arg >> c.targetPath >> c.sourcePath >> c.points >> c.interval;
+		arg.endStructure();
+		return arg;
+	}
+};
+
+// Values of a DynamicReadable over a time range
+struct HistoryBucket {
+	double min;
+	double max;
+	double average;
+	// Number of samples, the values are NaN if there are none
+	uint count;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const HistoryBucket b) {
+		arg.beginStructure();
+		arg << b.min << b.max << b.average << b.count;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, HistoryBucket &b) {
+		arg.beginStructure();
+		arg >> b.min >> b.max >> b.average >> b.count;
+		arg.endStructure();
+		return arg;
+	}
+};
+
+// Circuit breaker of a node that isn't closed, ie. whose reads are being skipped
+struct CircuitBreakerState {
+	QString path;
+	// 1: open, 2: half open (a trial read is allowed or in progress)
+	uchar state;
+	// Failed or timed out reads in a row
+	uint failures;
+	// Nanoseconds until the next trial read, zero if it's due
+	qulonglong retryIn;
+	friend QDBusArgument &operator<<(QDBusArgument &arg, const CircuitBreakerState s) {
+		arg.beginStructure();
+		arg << s.path << s.state << s.failures << s.retryIn;
+		arg.endStructure();
+		return arg;
+	}
+	friend const QDBusArgument &operator>>(const QDBusArgument &arg, CircuitBreakerState &s) {
+		arg.beginStructure();
+		arg >> s.path >> s.state >> s.failures >> s.retryIn;
+		arg.endStructure();
+		return arg;
+	}
+};
+
 template <typename T> struct FlatTreeNode {
 	T value;
 	QVector<int> childIndices;
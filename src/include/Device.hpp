@@ -1,8 +1,13 @@
 #pragma once
 
+#include <chrono>
 #include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
@@ -43,8 +48,41 @@ using RangeInfo = std::variant<Range<int>, Range<double>>;
 using EnumerationVec = std::vector<Enumeration>;
 using AssignableInfo = std::variant<RangeInfo, std::vector<Enumeration>>;
 
+// Called once with the result of an asynchronous call, from any thread
+template <typename T> using Completion = std::function<void(T)>;
+
+// Result of an asynchronous function for callers that need it right away
+template <typename T> T waitFor(const std::function<void(Completion<T>)> &asyncFunc) {
+	auto promise = std::make_shared<std::promise<T>>();
+	auto future = promise->get_future();
+	asyncFunc([promise](T result) { promise->set_value(std::move(result)); });
+	return future.get();
+}
+
+/* Assignables whose changes are applied to the hardware together, like entries of a table that
+   is committed at once, can share a Transaction. When they're assigned in a batch, 'begin' is
+   called once, then the staging function of each Assignable, then 'commit' once. */
+class Transaction {
+public:
+	Transaction(const std::function<std::optional<AssignmentError>()> beginFunc,
+	    const std::function<std::optional<AssignmentError>()> commitFunc) {
+		m_beginFunc = beginFunc;
+		m_commitFunc = commitFunc;
+	}
+	std::optional<AssignmentError> begin() { return m_beginFunc(); }
+	std::optional<AssignmentError> commit() { return m_commitFunc(); }
+private:
+	std::function<std::optional<AssignmentError>()> m_beginFunc;
+	std::function<std::optional<AssignmentError>()> m_commitFunc;
+};
+
 class Assignable {
 public:
+	using AsyncAssignmentFunc = std::function<void(
+	    AssignmentArgument, Completion<std::optional<AssignmentError>>)>;
+	using AsyncCurrentValueFunc =
+	    std::function<void(Completion<std::optional<AssignmentArgument>>)>;
+
 	Assignable(
 	    const std::function<std::optional<AssignmentError>(AssignmentArgument)> assignmentFunc,
 	    AssignableInfo info,
@@ -55,33 +93,231 @@ public:
 		m_currentValueFunc = currentValueFunc;
 		m_unit = unit;
 	}
+	/* For hardware with latency worth overlapping, eg. a request to a device's firmware. The
+	   functions pass the result to their completion and can return before that. They may
+	   complete after the Assignable is destroyed, so they shouldn't refer to it. */
+	Assignable(const AsyncAssignmentFunc asyncAssignmentFunc, AssignableInfo info,
+	    const AsyncCurrentValueFunc asyncCurrentValueFunc,
+	    std::optional<std::string> unit = std::nullopt) {
+		m_asyncAssignmentFunc = asyncAssignmentFunc;
+		m_assignableInfo = info;
+		m_asyncCurrentValueFunc = asyncCurrentValueFunc;
+		m_unit = unit;
+	}
+	// Waits for asynchronous Assignables
 	std::optional<AssignmentError> assign(AssignmentArgument arg) {
+		if (isAsync())
+			return waitFor<std::optional<AssignmentError>>(
+			    [&](auto done) { m_asyncAssignmentFunc(arg, std::move(done)); });
 		return m_assignmentFunc(arg);
 	}
-	// What the Assignable is currently set to
-	std::optional<AssignmentArgument> currentValue() { return m_currentValueFunc(); }
+	// What the Assignable is currently set to. Waits for asynchronous Assignables
+	std::optional<AssignmentArgument> currentValue() {
+		if (isAsync())
+			return waitFor<std::optional<AssignmentArgument>>(m_asyncCurrentValueFunc);
+		return m_currentValueFunc();
+	}
+	// Synchronous Assignables complete before returning
+	void assignAsync(AssignmentArgument arg, Completion<std::optional<AssignmentError>> done) {
+		if (isAsync())
+			m_asyncAssignmentFunc(arg, std::move(done));
+		else
+			done(m_assignmentFunc(arg));
+	}
+	void currentValueAsync(Completion<std::optional<AssignmentArgument>> done) {
+		if (isAsync())
+			m_asyncCurrentValueFunc(std::move(done));
+		else
+			done(m_currentValueFunc());
+	}
+	bool isAsync() const { return static_cast<bool>(m_asyncCurrentValueFunc); }
 	AssignableInfo assignableInfo() { return m_assignableInfo; }
 	std::optional<std::string> unit() { return m_unit; }
+	// 'stageFunc' makes the change without applying it, 'transaction' applies it
+	void setTransaction(std::shared_ptr<Transaction> transaction,
+	    const std::function<std::optional<AssignmentError>(AssignmentArgument)> stageFunc) {
+		m_transaction = transaction;
+		m_stageFunc = stageFunc;
+	}
+	// Null if assign() needs to be used
+	std::shared_ptr<Transaction> transaction() { return m_transaction; }
+	std::optional<AssignmentError> stage(AssignmentArgument arg) { return m_stageFunc(arg); }
 private:
 	AssignableInfo m_assignableInfo;
 	std::function<std::optional<AssignmentError>(AssignmentArgument)> m_assignmentFunc;
 	std::function<std::optional<AssignmentArgument>()> m_currentValueFunc;
+	AsyncAssignmentFunc m_asyncAssignmentFunc;
+	AsyncCurrentValueFunc m_asyncCurrentValueFunc;
 	std::optional<std::string> m_unit;
+	std::shared_ptr<Transaction> m_transaction;
+	std::function<std::optional<AssignmentError>(AssignmentArgument)> m_stageFunc;
+};
+
+// How expensive a read is compared to reading a sysfs file
+enum class ReadCost {
+	Unknown,
+	Cheap,
+	// Blocks for a noticeable time or parses a lot, eg. /proc/stat
+	Expensive
 };
 
+// How fast a value changes compared to the default sampling interval
+enum class Volatility {
+	Unknown,
+	// Changes over seconds or more, eg. temperatures
+	Low,
+	// Changes between every read, eg. utilizations
+	High
+};
+
+// Tells a poller how a DynamicReadable should be read. All of them are optional
+struct SamplingHints {
+	// Reads closer together than this aren't meaningful, eg. for values derived from
+	// counters between two reads. Zero for no minimum
+	std::chrono::milliseconds minimumInterval{0};
+	ReadCost cost = ReadCost::Unknown;
+	Volatility volatility = Volatility::Unknown;
+};
+
+/* Reads a numeric value through a plain function and a context, eg. the index of a device or a
+   sensor in a table of the plugin, instead of a std::function capturing the data of a device.
+   Cheap to copy, and the type of the value is known without a ReadResult to look into. The
+   function returns false on error. Passing the value out through a reference instead of a
+   std::optional keeps it in a register, which is most of the cost of a read otherwise. */
+template <typename T> struct TypedReader {
+	static_assert(std::is_same_v<T, int> || std::is_same_v<T, uint> ||
+		      std::is_same_v<T, double>,
+	    "Only numeric values can be read with a TypedReader");
+	using Value = T;
+	bool (*func)(uint32_t context, T &value);
+	uint32_t context;
+
+	bool read(T &value) const { return func(context, value); }
+};
+
+// Same order as the numeric alternatives of ReadableValue
+using TypedReadFunc = std::variant<TypedReader<int>, TypedReader<uint>, TypedReader<double>>;
+
+class ReadableGroup;
+
 class DynamicReadable {
 public:
+	using AsyncReadFunc = std::function<void(Completion<ReadResult>)>;
+
 	DynamicReadable() {}
 	DynamicReadable(const std::function<std::variant<ReadError, ReadableValue>()> readFunc,
-	    std::optional<std::string> unit = std::nullopt) {
+	    std::optional<std::string> unit = std::nullopt, SamplingHints hints = {}) {
 		m_readFunc = readFunc;
 		m_unit = unit;
+		m_hints = hints;
+	}
+	// For values read often, see TypedReader
+	DynamicReadable(TypedReadFunc typedReader, std::optional<std::string> unit = std::nullopt,
+	    SamplingHints hints = {}) {
+		m_typedReader = typedReader;
+		m_unit = unit;
+		m_hints = hints;
+	}
+	/* For reads with latency worth overlapping, eg. a query to a GPU that is answered later.
+	   The daemon starts the reads of a device together and waits for all of them. 'readFunc'
+	   passes the result to its completion and can return before that. It may complete after
+	   the DynamicReadable is destroyed, so it shouldn't refer to it. */
+	DynamicReadable(const AsyncReadFunc asyncReadFunc,
+	    std::optional<std::string> unit = std::nullopt, SamplingHints hints = {}) {
+		m_asyncReadFunc = asyncReadFunc;
+		m_unit = unit;
+		m_hints = hints;
+	}
+	// Waits for asynchronous readables
+	/*std::variant<ReadError, ReadableValue>*/ ReadResult read() {
+		if (isAsync())
+			return waitFor(m_asyncReadFunc);
+		if (m_typedReader.has_value())
+			return std::visit(
+			    [](auto &reader) -> ReadResult {
+				    typename std::decay_t<decltype(reader)>::Value value;
+				    if (!reader.read(value))
+					    return ReadError::UnknownError;
+				    return ReadableValue{value};
+			    },
+			    *m_typedReader);
+		return m_readFunc();
 	}
-	/*std::variant<ReadError, ReadableValue>*/ ReadResult read() { return m_readFunc(); }
+	// Synchronous readables complete before returning
+	void readAsync(Completion<ReadResult> done) {
+		if (isAsync())
+			m_asyncReadFunc(std::move(done));
+		else
+			done(read());
+	}
+	bool isAsync() const { return static_cast<bool>(m_asyncReadFunc); }
+	// Lets callers skip read() and ReadResult
+	const std::optional<TypedReadFunc> &typedReader() const { return m_typedReader; }
 	auto unit() { return m_unit; }
+	const SamplingHints &hints() const { return m_hints; }
+	// Group the value is read with, null if it's read alone
+	const std::shared_ptr<ReadableGroup> &group() const { return m_group; }
+	// Position of the value in the results of the group
+	size_t groupIndex() const { return m_groupIndex; }
 private:
+	friend class ReadableGroup;
 	std::function<std::variant<ReadError, ReadableValue>()> m_readFunc;
+	AsyncReadFunc m_asyncReadFunc;
+	std::optional<TypedReadFunc> m_typedReader;
 	std::optional<std::string> m_unit;
+	SamplingHints m_hints;
+	std::shared_ptr<ReadableGroup> m_group;
+	size_t m_groupIndex = 0;
+};
+
+/* Values read together in one pass, eg. the utilizations of all cores from one read of
+   /proc/stat. 'readFunc' returns the results of all members in the order of their indices, or
+   nothing if the pass failed. The value of a member comes from a pass started at most 'maxAge'
+   before it's read, and passes aren't started closer together than that, so values derived
+   from counters between passes stay meaningful. Reads that come during a pass wait for it
+   instead of starting another one. Needs to be owned by a shared_ptr for member(). */
+class ReadableGroup : public std::enable_shared_from_this<ReadableGroup> {
+public:
+	using Clock = std::chrono::steady_clock;
+	struct Pass {
+		// When the pass was started
+		Clock::time_point time;
+		std::vector<ReadResult> results;
+	};
+
+	ReadableGroup(const std::function<std::vector<ReadResult>()> readFunc,
+	    std::chrono::milliseconds maxAge) {
+		m_readFunc = readFunc;
+		m_maxAge = maxAge;
+	}
+	// Latest pass if it's fresh enough, otherwise a new one
+	std::shared_ptr<const Pass> read() {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		auto now = Clock::now();
+		if (!m_pass || now - m_pass->time > m_maxAge)
+			m_pass = std::make_shared<const Pass>(Pass{now, m_readFunc()});
+		return m_pass;
+	}
+	ReadResult read(size_t index) { return result(*read(), index); }
+	static ReadResult result(const Pass &pass, size_t index) {
+		if (index >= pass.results.size())
+			return ReadError::UnknownError;
+		return pass.results[index];
+	}
+	// Readable of the value at 'index' in the results
+	DynamicReadable member(size_t index, std::optional<std::string> unit = std::nullopt,
+	    SamplingHints hints = {}) {
+		auto group = shared_from_this();
+		DynamicReadable retval{[group, index] { return group->read(index); }, unit, hints};
+		retval.m_group = group;
+		retval.m_groupIndex = index;
+		return retval;
+	}
+private:
+	std::function<std::vector<ReadResult>()> m_readFunc;
+	std::chrono::milliseconds m_maxAge;
+	std::mutex m_mutex;
+	std::shared_ptr<const Pass> m_pass;
 };
 
 class StaticReadable {
@@ -38,6 +38,9 @@ public:
 	// communicate it.
 	virtual std::optional<InitializationError> initializationError() = 0;
 	virtual TreeNode<DeviceNode> deviceRootNode() = 0;
+	// Kernel subsystems whose device events can change the plugin's devices, eg. "drm".
+	// deviceRootNode() is called again from another thread after such events
+	virtual std::vector<std::string> hotplugSubsystems() { return {}; }
 	virtual ~DevicePlugin() {}
 
 	// Helper for loading all DevicePlugin's
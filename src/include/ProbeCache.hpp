@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+/* Remembers which device nodes exist between daemon starts, so plugins don't need to read
+   every possible value from the hardware at startup to find out. Entries are keyed by node
+   hash and only valid for the hardware and software the fingerprint was computed from. */
+
+namespace TuxClocker::ProbeCache {
+
+// Changes when devices, drivers or the kernel change
+std::string hardwareFingerprint();
+
+// Uses the results in 'path' if they were saved with the same fingerprint, otherwise starts
+// with an empty cache
+void load(const std::string &path, const std::string &fingerprint);
+bool save(const std::string &path);
+
+// Calls 'probe' and remembers the result if 'key' isn't in the cache yet. Thread safe
+bool probe(const std::string &key, const std::function<bool()> &probe);
+
+struct Statistics {
+	int hits;
+	int misses;
+};
+Statistics statistics();
+
+}; // namespace TuxClocker::ProbeCache
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace TuxClocker {
+
+// Which ReadableValue alternative a sample was read as, same order as in the variant
+enum class SampleType : uint8_t {
+	Int,
+	UInt,
+	Double
+};
+
+/* Value of a DynamicReadable at some point in time, as the daemon keeps, records and sends it.
+   Fixed size and trivially copyable, so arrays of them can be copied with memcpy, shared with
+   other processes and processed a field at a time. Strings like paths and units are static,
+   and are looked up by 'index' instead of stored with every sample. */
+struct SampleRecord {
+	// Nanoseconds on the daemon's monotonic clock. Zero if never sampled
+	uint64_t timestamp;
+	// Index of the readable in the daemon
+	uint32_t index;
+	// Samples stored for the readable up to this one, so a new sample of an unchanged value
+	// can be told from the same sample read twice. Wraps around
+	uint32_t sequence;
+	uint8_t error;
+	SampleType type;
+	uint8_t reserved[6];
+	// Error code if 'error' is set. Integer values are exactly representable as double
+	double value;
+};
+static_assert(sizeof(SampleRecord) == 32);
+static_assert(std::is_trivially_copyable_v<SampleRecord>);
+static_assert(std::is_standard_layout_v<SampleRecord>);
+
+}; // namespace TuxClocker
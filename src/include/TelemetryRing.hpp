@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <SampleRecord.hpp>
+#include <string>
+#include <vector>
+
+/* Ring buffer of samples in shared memory, written by the daemon and read by clients through
+   a file descriptor without per-sample messages. Layout: RingHeader, NUL separated paths of
+   the readables the records refer to, the records. */
+
+namespace TuxClocker::Telemetry {
+
+constexpr uint32_t ringMagic = 0x31524354; // "TCR1"
+constexpr uint32_t ringVersion = 2;
+
+// Samples are recorded as they're kept in the daemon. 'index' is the index of the path
+using RingRecord = SampleRecord;
+
+struct RingHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t recordSize;
+	// Power of two
+	uint32_t capacity;
+	uint64_t pathsOffset;
+	uint64_t pathsSize;
+	uint64_t recordsOffset;
+	// Record n is stored at n % capacity. 'writing' is incremented before a record is
+	// written and 'written' after, so readers can detect records overwritten while reading
+	alignas(64) std::atomic<uint64_t> writing;
+	std::atomic<uint64_t> written;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+// Only one thread may write at a time
+class RingWriter {
+public:
+	// 'capacity' is rounded up to a power of two
+	static std::optional<RingWriter> create(
+	    const std::vector<std::string> &paths, uint32_t capacity);
+	RingWriter(RingWriter &&other);
+	RingWriter(const RingWriter &) = delete;
+	RingWriter &operator=(const RingWriter &) = delete;
+	~RingWriter();
+	void write(const RingRecord &record);
+	// New read-only descriptor for a reader, owned by the caller
+	std::optional<int> readOnlyFd() const;
+private:
+	RingWriter(int fd, void *memory, size_t size);
+
+	int m_fd;
+	void *m_memory;
+	size_t m_size;
+	RingHeader *m_header;
+	RingRecord *m_records;
+};
+
+class RingReader {
+public:
+	// Takes ownership of 'fd'. Reading starts from the records written after opening
+	static std::optional<RingReader> open(int fd);
+	RingReader(RingReader &&other);
+	RingReader(const RingReader &) = delete;
+	RingReader &operator=(const RingReader &) = delete;
+	~RingReader();
+	// Paths of the readables, indexed by RingRecord::index
+	const std::vector<std::string> &paths() const { return m_paths; }
+	uint32_t capacity() const { return m_header->capacity; }
+	/* Appends the records written since the previous call to 'records'. Returns how many
+	   records were overwritten before they could be read, ie. if the reader fell behind */
+	uint64_t read(std::vector<RingRecord> &records);
+private:
+	RingReader(int fd, const void *memory, size_t size);
+
+	int m_fd;
+	const void *m_memory;
+	size_t m_size;
+	const RingHeader *m_header;
+	const RingRecord *m_records;
+	std::vector<std::string> m_paths;
+	// Next record to read
+	uint64_t m_position;
+};
+
+}; // namespace TuxClocker::Telemetry
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace TuxClocker {
@@ -12,78 +15,210 @@ template <typename T> struct FlatTreeNode {
 };
 
 template <typename T> class TreeNode;
+template <typename T> class TreeArena;
 
+// Nodes in preorder, so the root is the first node and children come after their parent
 template <typename T> struct FlatTree {
 	std::vector<FlatTreeNode<T>> nodes;
 
+	// Values are moved out of 'flatTree'
 	static TreeNode<T> toTree(FlatTree<T> flatTree) {
-		std::function<void(TreeNode<T> *, uint)> recur;
-		recur = [&recur, flatTree](TreeNode<T> *node, uint i) {
-			auto c_indices = flatTree.nodes[i].childIndices;
-			for (auto index : c_indices)
-				node->appendChild(TreeNode<T>(flatTree.nodes[index].value));
-
-			uint j = 0;
-			for (auto &c_node : *(node->childrenPtr())) {
-				recur(&c_node, c_indices[j]);
-				j++;
-			}
-		};
-		TreeNode<T> root;
-		if (flatTree.nodes.size() > 0) {
-			auto realRoot = TreeNode<T>(flatTree.nodes.front().value);
-			recur(&realRoot, 0);
-			root = realRoot;
+		if (flatTree.nodes.empty())
+			return TreeNode<T>{};
+		return build(flatTree.nodes, 0);
+	}
+private:
+	static TreeNode<T> build(std::vector<FlatTreeNode<T>> &nodes, int index) {
+		TreeNode<T> node{std::move(nodes[index].value)};
+		auto &childIndices = nodes[index].childIndices;
+		node.childrenPtr()->reserve(childIndices.size());
+		for (auto childIndex : childIndices) {
+			// Also keeps malformed trees from recursing forever
+			if (childIndex <= index || childIndex >= static_cast<int>(nodes.size()))
+				continue;
+			node.appendChild(build(nodes, childIndex));
 		}
-		return root;
+		return node;
 	}
 };
 
 template <typename T> class TreeNode {
 public:
 	TreeNode(){};
-	TreeNode(T value) { m_value = value; }
-	void appendChild(T value) { m_children.push_back(TreeNode{value}); }
-	void appendChild(TreeNode<T> node) { m_children.push_back(node); }
-	std::vector<TreeNode<T>> children() { return m_children; }
+	TreeNode(T value) : m_value(std::move(value)) {}
+	void appendChild(T value) { m_children.emplace_back(std::move(value)); }
+	void appendChild(TreeNode<T> node) { m_children.push_back(std::move(node)); }
+	const std::vector<TreeNode<T>> &children() const & { return m_children; }
+	std::vector<TreeNode<T>> children() && { return std::move(m_children); }
 	// Needed for recursive tree construction
 	std::vector<TreeNode<T>> *childrenPtr() { return &m_children; }
-	static void preorder(const TreeNode<T> node, std::function<void(const T)> func) {
+	static void preorder(const TreeNode<T> &node, const std::function<void(const T &)> &func) {
 		func(node.m_value);
-		for (const auto child : node.m_children) {
+		for (const auto &child : node.m_children)
 			preorder(child, func);
-		}
 	}
-	T value() { return m_value; }
+	const T &value() const & { return m_value; }
+	T value() && { return std::move(m_value); }
+	// Amount of nodes including this one
+	size_t size() const {
+		size_t retval = 1;
+		for (auto &child : m_children)
+			retval += child.size();
+		return retval;
+	}
 	// Convert tree to array
-	FlatTree<T> toFlatTree() {
-		std::vector<FlatTreeNode<T>> nodes;
-		auto node_ptr = this;
-		preorderByRef(node_ptr, [&nodes, node_ptr](TreeNode<T> *n) {
-			FlatTreeNode<T> node;
-			node.value = n->value();
-			for (auto &c_node : *(n->childrenPtr())) {
-				// Find the index of this child node
-				int j = 0, index = 0;
-
-				preorderByRef(node_ptr, [&j, &index, &c_node](TreeNode<T> *n) {
-					if (n == &c_node)
-						index = j;
-					j++;
-				});
-				node.childIndices.push_back(index);
-			}
-			nodes.push_back(node);
-		});
-		return FlatTree<T>{nodes};
+	FlatTree<T> toFlatTree() const & {
+		FlatTree<T> retval;
+		retval.nodes.reserve(size());
+		flatten(*this, retval.nodes);
+		return retval;
+	}
+	// Moves the values instead of copying them
+	FlatTree<T> toFlatTree() && {
+		FlatTree<T> retval;
+		retval.nodes.reserve(size());
+		flatten(std::move(*this), retval.nodes);
+		return retval;
 	}
 private:
 	T m_value;
 	std::vector<TreeNode<T>> m_children;
-	static void preorderByRef(TreeNode<T> *node, std::function<void(TreeNode<T> *)> func) {
-		func(node);
-		for (auto &c_node : *(node->childrenPtr()))
-			preorderByRef(&c_node, func);
+
+	// Index of a child is the amount of nodes before it in preorder
+	template <typename Node>
+	static void flatten(Node &&node, std::vector<FlatTreeNode<T>> &nodes) {
+		auto index = nodes.size();
+		nodes.push_back({std::forward<Node>(node).m_value, {}});
+		nodes[index].childIndices.reserve(node.m_children.size());
+		for (auto &child : node.m_children) {
+			nodes[index].childIndices.push_back(nodes.size());
+			if constexpr (std::is_lvalue_reference_v<Node>)
+				flatten(child, nodes);
+			else
+				flatten(std::move(child), nodes);
+		}
+	}
+};
+
+// Read-only node of a TreeArena, refers to the arena instead of copying
+template <typename T> class TreeView {
+public:
+	// Views of the children of a node, which are next to each other in the arena
+	class Children {
+	public:
+		class Iterator {
+		public:
+			Iterator(const TreeArena<T> *arena, uint32_t index)
+			    : m_arena(arena), m_index(index) {}
+			TreeView<T> operator*() const { return {m_arena, m_index}; }
+			Iterator &operator++() {
+				m_index++;
+				return *this;
+			}
+			bool operator!=(const Iterator &other) const {
+				return m_index != other.m_index;
+			}
+		private:
+			const TreeArena<T> *m_arena;
+			uint32_t m_index;
+		};
+		Children(const TreeArena<T> *arena, uint32_t begin, uint32_t end)
+		    : m_arena(arena), m_begin(begin), m_end(end) {}
+		Iterator begin() const { return {m_arena, m_begin}; }
+		Iterator end() const { return {m_arena, m_end}; }
+		size_t size() const { return m_end - m_begin; }
+		bool empty() const { return m_begin == m_end; }
+		TreeView<T> operator[](size_t i) const {
+			return {m_arena, static_cast<uint32_t>(m_begin + i)};
+		}
+	private:
+		const TreeArena<T> *m_arena;
+		uint32_t m_begin;
+		uint32_t m_end;
+	};
+
+	TreeView(const TreeArena<T> *arena, uint32_t index) : m_arena(arena), m_index(index) {}
+	const T &value() const { return m_arena->m_nodes[m_index].value; }
+	Children children() const {
+		auto &node = m_arena->m_nodes[m_index];
+		return {m_arena, node.firstChild, node.firstChild + node.childCount};
+	}
+	// Position in the arena
+	uint32_t index() const { return m_index; }
+	static void preorder(TreeView<T> node, const std::function<void(const T &)> &func) {
+		func(node.value());
+		for (auto child : node.children())
+			preorder(child, func);
+	}
+	// Copy of the subtree, for code that needs a TreeNode
+	TreeNode<T> toTree() const {
+		TreeNode<T> retval{value()};
+		auto nodeChildren = children();
+		retval.childrenPtr()->reserve(nodeChildren.size());
+		for (auto child : nodeChildren)
+			retval.appendChild(child.toTree());
+		return retval;
+	}
+private:
+	const TreeArena<T> *m_arena;
+	uint32_t m_index;
+};
+
+/* Tree with all nodes in one vector instead of a vector of children per node. Nodes are in
+   breadth-first order, so the children of a node are next to each other and are referred to by
+   the index of the first one. Nodes are read through TreeViews, which become invalid when the
+   arena is moved. */
+template <typename T> class TreeArena {
+public:
+	// Values are moved out of 'root'
+	explicit TreeArena(TreeNode<T> root) {
+		m_nodes.reserve(root.size());
+		m_nodes.push_back({std::move(root).value(), 0, 0});
+		// Nodes whose children haven't been added yet, with their index in the arena
+		std::vector<std::pair<TreeNode<T> *, uint32_t>> queue{{&root, 0}};
+		queue.reserve(m_nodes.capacity());
+		for (size_t i = 0; i < queue.size(); i++) {
+			auto [node, index] = queue[i];
+			auto &nodeChildren = *node->childrenPtr();
+			m_nodes[index].firstChild = m_nodes.size();
+			m_nodes[index].childCount = nodeChildren.size();
+			for (auto &child : nodeChildren) {
+				queue.push_back({&child, static_cast<uint32_t>(m_nodes.size())});
+				m_nodes.push_back({std::move(child).value(), 0, 0});
+			}
+		}
+	}
+	// Copying all nodes is what this is here to avoid
+	TreeArena(const TreeArena &) = delete;
+	TreeArena(TreeArena &&) = default;
+	TreeArena &operator=(TreeArena &&) = default;
+	TreeView<T> root() const { return {this, 0}; }
+	size_t size() const { return m_nodes.size(); }
+	// Same preorder layout as TreeNode::toFlatTree()
+	FlatTree<T> toFlatTree() const {
+		FlatTree<T> retval;
+		retval.nodes.reserve(m_nodes.size());
+		flatten(root(), retval.nodes);
+		return retval;
+	}
+private:
+	friend class TreeView<T>;
+	struct Node {
+		T value;
+		uint32_t firstChild;
+		uint32_t childCount;
+	};
+	std::vector<Node> m_nodes;
+
+	static void flatten(TreeView<T> node, std::vector<FlatTreeNode<T>> &nodes) {
+		auto index = nodes.size();
+		nodes.push_back({node.value(), {}});
+		auto nodeChildren = node.children();
+		nodes[index].childIndices.reserve(nodeChildren.size());
+		for (auto child : nodeChildren) {
+			nodes[index].childIndices.push_back(nodes.size());
+			flatten(child, nodes);
+		}
 	}
 };
 
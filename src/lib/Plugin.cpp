@@ -1,6 +1,10 @@
 #include <Plugin.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <future>
+#include <iostream>
 #include <sstream>
 
 using namespace TuxClocker::Plugin;
@@ -21,15 +25,41 @@ std::optional<std::vector<boost::shared_ptr<DevicePlugin>>> DevicePlugin::loadPl
 	else
 		pluginPath = Plugin::pluginPath();
 
-	for (const fs::directory_entry &entry : fs::directory_iterator(pluginPath)) {
-		// Bleh, have to catch this unless I do more manual checks
-		try {
-			auto plugin = boost::dll::import_symbol<DevicePlugin>(
-			    entry.path().string(), TUXCLOCKER_PLUGIN_SYMBOL_NAME);
-			retval.push_back(plugin);
-			std::cout << "found plugin at " << entry.path().string() << "\n";
-		} catch (boost::system::system_error &e) {
-		}
+	// Sorted so plugins are always returned in the same order
+	std::vector<std::string> paths;
+	for (const fs::directory_entry &entry : fs::directory_iterator(pluginPath))
+		paths.push_back(entry.path().string());
+	std::sort(paths.begin(), paths.end());
+
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+	struct LoadResult {
+		boost::shared_ptr<DevicePlugin> plugin;
+		Milliseconds duration;
+	};
+	// Plugins initialize their libraries when loaded, so load them concurrently
+	std::vector<std::future<LoadResult>> futures;
+	for (auto &path : paths) {
+		futures.push_back(std::async(std::launch::async, [path] {
+			auto start = std::chrono::steady_clock::now();
+			LoadResult result;
+			// Bleh, have to catch this unless I do more manual checks
+			try {
+				result.plugin = boost::dll::import_symbol<DevicePlugin>(
+				    path, TUXCLOCKER_PLUGIN_SYMBOL_NAME);
+			} catch (boost::system::system_error &e) {
+			}
+			result.duration = std::chrono::steady_clock::now() - start;
+			return result;
+		}));
+	}
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		auto result = futures[i].get();
+		if (!result.plugin)
+			continue;
+		retval.push_back(result.plugin);
+		std::cout << "found plugin at " << paths[i] << " (loaded in "
+			  << result.duration.count() << " ms)\n";
 	}
 
 	if (retval.empty())
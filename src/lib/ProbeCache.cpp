@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <Crypto.hpp>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <ProbeCache.hpp>
+#include <sstream>
+#include <sys/utsname.h>
+#include <unordered_map>
+#include <vector>
+
+namespace TuxClocker::ProbeCache {
+
+namespace fs = std::filesystem;
+
+const std::string cacheHeader = "tuxclocker-probe-cache 1";
+
+static std::mutex mutex;
+static std::unordered_map<std::string, bool> results;
+static std::string currentFingerprint;
+static Statistics stats{0, 0};
+
+std::string firstLine(const fs::path &path) {
+	std::ifstream file{path};
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+std::string hardwareFingerprint() {
+	std::vector<std::string> parts;
+
+	std::error_code ec;
+	for (auto &entry : fs::directory_iterator("/sys/bus/pci/devices", ec)) {
+		auto dir = entry.path();
+		std::string device = dir.filename().string();
+		for (auto file : {"vendor", "device", "subsystem_vendor", "subsystem_device"})
+			device += " " + firstLine(dir / file);
+		auto driver = fs::read_symlink(dir / "driver", ec);
+		if (!ec)
+			device += " " + driver.filename().string();
+		parts.push_back(device);
+	}
+	// Directory iteration order isn't specified
+	std::sort(parts.begin(), parts.end());
+
+	std::ifstream cpuinfo{"/proc/cpuinfo"};
+	std::string line, model;
+	int processors = 0;
+	while (std::getline(cpuinfo, line)) {
+		if (line.rfind("processor", 0) == 0)
+			processors++;
+		if (model.empty() && line.rfind("model name", 0) == 0)
+			model = line;
+	}
+	parts.push_back(model + " " + std::to_string(processors));
+
+	utsname name;
+	if (uname(&name) == 0)
+		parts.push_back(name.release);
+
+	for (auto module : {"nvidia", "amdgpu"})
+		parts.push_back(firstLine(fs::path{"/sys/module"} / module / "version"));
+
+	std::string data;
+	for (auto &part : parts)
+		data += part + "\n";
+	return Crypto::sha256(data);
+}
+
+void load(const std::string &path, const std::string &fingerprint) {
+	std::lock_guard<std::mutex> lock{mutex};
+	results.clear();
+	currentFingerprint = fingerprint;
+
+	std::ifstream file{path};
+	std::string line;
+	if (!std::getline(file, line) || line != cacheHeader)
+		return;
+	// Different devices, drivers or versions, probe everything again
+	if (!std::getline(file, line) || line != fingerprint)
+		return;
+
+	while (std::getline(file, line)) {
+		std::istringstream stream{line};
+		std::string key;
+		int result;
+		if (stream >> key >> result)
+			results[key] = result != 0;
+	}
+}
+
+bool save(const std::string &path) {
+	std::lock_guard<std::mutex> lock{mutex};
+	// Write to a temporary file so a crash can't leave a truncated cache behind
+	auto tmpPath = path + ".tmp";
+	{
+		std::ofstream file{tmpPath, std::ios::trunc};
+		if (!file)
+			return false;
+		file << cacheHeader << "\n" << currentFingerprint << "\n";
+		for (auto &[key, result] : results)
+			file << key << " " << result << "\n";
+		if (!file.flush())
+			return false;
+	}
+	std::error_code ec;
+	fs::rename(tmpPath, path, ec);
+	return !ec;
+}
+
+bool probe(const std::string &key, const std::function<bool()> &probe) {
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+		auto it = results.find(key);
+		if (it != results.end()) {
+			stats.hits++;
+			return it->second;
+		}
+	}
+	// Don't hold the lock while other plugins could be probing
+	auto result = probe();
+	std::lock_guard<std::mutex> lock{mutex};
+	stats.misses++;
+	results[key] = result;
+	return result;
+}
+
+Statistics statistics() {
+	std::lock_guard<std::mutex> lock{mutex};
+	return stats;
+}
+
+}; // namespace TuxClocker::ProbeCache
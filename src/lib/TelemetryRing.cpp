@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <TelemetryRing.hpp>
+#include <unistd.h>
+
+namespace TuxClocker::Telemetry {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t nextPowerOfTwo(uint32_t value) {
+	uint32_t retval = 1;
+	while (retval < value)
+		retval <<= 1;
+	return retval;
+}
+
+std::optional<RingWriter> RingWriter::create(
+    const std::vector<std::string> &paths, uint32_t capacity) {
+	capacity = nextPowerOfTwo(std::max(capacity, 1u));
+
+	std::string pathData;
+	for (auto &path : paths) {
+		pathData += path;
+		pathData.push_back('\0');
+	}
+	auto pathsOffset = alignUp(sizeof(RingHeader), 64);
+	auto recordsOffset = alignUp(pathsOffset + pathData.size(), 64);
+	auto size = recordsOffset + static_cast<uint64_t>(capacity) * sizeof(RingRecord);
+
+	int fd = memfd_create("tuxclocker-telemetry", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return std::nullopt;
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return std::nullopt;
+	}
+	// Readers can rely on the size staying the same
+	fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+	auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED) {
+		close(fd);
+		return std::nullopt;
+	}
+	auto header = new (memory) RingHeader;
+	header->magic = ringMagic;
+	header->version = ringVersion;
+	header->recordSize = sizeof(RingRecord);
+	header->capacity = capacity;
+	header->pathsOffset = pathsOffset;
+	header->pathsSize = pathData.size();
+	header->recordsOffset = recordsOffset;
+	header->writing.store(0, std::memory_order_relaxed);
+	header->written.store(0, std::memory_order_release);
+	std::memcpy(static_cast<char *>(memory) + pathsOffset, pathData.data(), pathData.size());
+
+	return RingWriter{fd, memory, size};
+}
+
+RingWriter::RingWriter(int fd, void *memory, size_t size)
+    : m_fd(fd), m_memory(memory), m_size(size) {
+	m_header = static_cast<RingHeader *>(memory);
+	m_records = reinterpret_cast<RingRecord *>(
+	    static_cast<char *>(memory) + m_header->recordsOffset);
+}
+
+RingWriter::RingWriter(RingWriter &&other)
+    : m_fd(other.m_fd), m_memory(other.m_memory), m_size(other.m_size),
+      m_header(other.m_header), m_records(other.m_records) {
+	other.m_fd = -1;
+	other.m_memory = nullptr;
+}
+
+RingWriter::~RingWriter() {
+	if (m_memory)
+		munmap(m_memory, m_size);
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+void RingWriter::write(const RingRecord &record) {
+	auto n = m_header->written.load(std::memory_order_relaxed);
+	m_header->writing.store(n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(&m_records[n & (m_header->capacity - 1)], &record, sizeof(RingRecord));
+
+	m_header->written.store(n + 1, std::memory_order_release);
+}
+
+std::optional<int> RingWriter::readOnlyFd() const {
+	// Reopening gives a descriptor that can't be used to map the memory writable
+	auto path = "/proc/self/fd/" + std::to_string(m_fd);
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return std::nullopt;
+	return fd;
+}
+
+std::optional<RingReader> RingReader::open(int fd) {
+	struct stat st;
+	if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+		close(fd);
+		return std::nullopt;
+	}
+	size_t size = st.st_size;
+	auto memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED) {
+		close(fd);
+		return std::nullopt;
+	}
+	auto header = static_cast<const RingHeader *>(memory);
+	auto capacity = static_cast<uint64_t>(header->capacity);
+	if (header->magic != ringMagic || header->version != ringVersion ||
+	    header->recordSize != sizeof(RingRecord) || capacity == 0 ||
+	    (capacity & (capacity - 1)) != 0 ||
+	    header->pathsOffset + header->pathsSize > size ||
+	    header->recordsOffset + capacity * sizeof(RingRecord) > size) {
+		munmap(memory, size);
+		close(fd);
+		return std::nullopt;
+	}
+	return RingReader{fd, memory, size};
+}
+
+RingReader::RingReader(int fd, const void *memory, size_t size)
+    : m_fd(fd), m_memory(memory), m_size(size) {
+	auto bytes = static_cast<const char *>(memory);
+	m_header = static_cast<const RingHeader *>(memory);
+	m_records = reinterpret_cast<const RingRecord *>(bytes + m_header->recordsOffset);
+
+	auto pathData = bytes + m_header->pathsOffset;
+	auto pathsEnd = pathData + m_header->pathsSize;
+	while (pathData < pathsEnd) {
+		auto length = strnlen(pathData, pathsEnd - pathData);
+		m_paths.emplace_back(pathData, length);
+		pathData += length + 1;
+	}
+	m_position = m_header->written.load(std::memory_order_acquire);
+}
+
+RingReader::RingReader(RingReader &&other)
+    : m_fd(other.m_fd), m_memory(other.m_memory), m_size(other.m_size),
+      m_header(other.m_header), m_records(other.m_records),
+      m_paths(std::move(other.m_paths)), m_position(other.m_position) {
+	other.m_fd = -1;
+	other.m_memory = nullptr;
+}
+
+RingReader::~RingReader() {
+	if (m_memory)
+		munmap(const_cast<void *>(m_memory), m_size);
+	if (m_fd >= 0)
+		close(m_fd);
+}
+
+uint64_t RingReader::read(std::vector<RingRecord> &records) {
+	uint64_t capacity = m_header->capacity;
+	auto written = m_header->written.load(std::memory_order_acquire);
+	uint64_t lost = 0;
+	if (written - m_position > capacity) {
+		lost = written - capacity - m_position;
+		m_position = written - capacity;
+	}
+
+	// At most two contiguous ranges since the records may wrap around
+	auto first = records.size();
+	records.resize(first + (written - m_position));
+	auto begin = m_position & (capacity - 1);
+	auto count = written - m_position;
+	auto head = std::min(count, capacity - begin);
+	std::memcpy(&records[first], &m_records[begin], head * sizeof(RingRecord));
+	std::memcpy(&records[first + head], m_records, (count - head) * sizeof(RingRecord));
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	// Records before 'writing - capacity' may have been overwritten while copying
+	auto writing = m_header->writing.load(std::memory_order_relaxed);
+	if (writing > capacity && writing - capacity > m_position) {
+		auto overwritten = std::min(writing - capacity, written) - m_position;
+		records.erase(records.begin() + first, records.begin() + first + overwritten);
+		lost += overwritten;
+	}
+	m_position = written;
+	return lost;
+}
+
+}; // namespace TuxClocker::Telemetry
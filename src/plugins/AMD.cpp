@@ -53,7 +53,7 @@ std::optional<AssignmentError> setPerformanceLevel(AssignmentArgument a, AMDGPUD
 	    "profile_standard", "profile_min_sclk", "profile_min_mclk", "profile_peak"};
 
 	auto path = data.devPath + "/power_dpm_force_performance_level";
-	std::ofstream file{path};
+	std::ofstream file{fsPath(path)};
 	if (!file.good())
 		return AssignmentError::UnknownError;
 
@@ -82,6 +82,43 @@ std::optional<AssignmentError> withManualPerformanceLevel(
 	return func(a);
 }
 
+// Writes a command like 's 0 500' to pp_od_clk_voltage, takes effect after commitOD()
+std::optional<AssignmentError> writeODCommand(const char *cmdString, AMDGPUData data) {
+	std::ofstream file{fsPath(data.devPath + "/pp_od_clk_voltage")};
+	if (file.good() && file << cmdString)
+		return std::nullopt;
+	return AssignmentError::UnknownError;
+}
+
+std::optional<AssignmentError> commitOD(AMDGPUData data) {
+	std::ofstream file{fsPath(data.devPath + "/pp_od_clk_voltage")};
+	if (file.good() && file << "c")
+		return std::nullopt;
+	return AssignmentError::UnknownError;
+}
+
+// Assignable for an entry of pp_od_clk_voltage. Assigning it commits the entry right away,
+// in a batch all entries of the GPU are committed with one command
+Assignable odAssignable(const AssignmentFunction &stageFunc, AssignableInfo info,
+    const std::function<std::optional<AssignmentArgument>()> &getFunc,
+    std::optional<std::string> unit, AMDGPUData data) {
+	auto setFunc = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
+		auto retval = stageFunc(a);
+		if (retval.has_value())
+			return retval;
+		return commitOD(data);
+	};
+
+	auto setWithPerfLevel = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
+		return withManualPerformanceLevel(setFunc, a, data);
+	};
+
+	Assignable assignable{setWithPerfLevel, info, getFunc, unit};
+	if (data.odTransaction)
+		assignable.setTransaction(data.odTransaction, stageFunc);
+	return assignable;
+}
+
 // Shared function to get memory and core clock pstate assignables
 std::optional<Assignable> vfPointClockAssignable(
     VoltFreqType vfType, uint pointIndex, Range<int> range, AMDGPUData data) {
@@ -138,21 +175,13 @@ std::optional<Assignable> vfPointClockAssignable(
 		if (vfType == MemoryPState)
 			target = toControllerClock(target, data);
 
-		std::ofstream file{data.devPath + "/pp_od_clk_voltage"};
 		char cmdString[32];
 		snprintf(
 		    cmdString, 32, "%s %u %i %i", typeString, pointIndex, target, vfPoint->voltage);
-
-		if (file << cmdString && file << "c")
-			return std::nullopt;
-		return AssignmentError::UnknownError;
-	};
-
-	auto setWithPerfLevel = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
-		return withManualPerformanceLevel(setFunc, a, data);
+		return writeODCommand(cmdString, data);
 	};
 
-	return Assignable{setWithPerfLevel, range, getFunc, _("MHz")};
+	return odAssignable(setFunc, range, getFunc, _("MHz"), data);
 }
 
 // Same as above, but for editing single values like min/max clocks
@@ -219,20 +248,12 @@ std::optional<Assignable> singleValueAssignable(SingleAssignableType type, uint
 		if (type == MemoryClock)
 			target = toControllerClock(target, data);
 
-		std::ofstream file{data.devPath + "/pp_od_clk_voltage"};
 		char cmdString[32];
 		snprintf(cmdString, 32, "%s %i %i", typeString, sysFsIndex, target);
-
-		if (file << cmdString && file << "c")
-			return std::nullopt;
-		return AssignmentError::UnknownError;
-	};
-
-	auto setWithPerfLevel = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
-		return withManualPerformanceLevel(setFunc, a, data);
+		return writeODCommand(cmdString, data);
 	};
 
-	return Assignable{setWithPerfLevel, range, getFunc, unit};
+	return odAssignable(setFunc, range, getFunc, unit, data);
 }
 
 std::optional<Assignable> vfPointVoltageAssignable(
@@ -282,36 +303,27 @@ std::optional<Assignable> vfPointVoltageAssignable(
 		if (!vfPoint.has_value())
 			return AssignmentError::UnknownError;
 
-		std::ofstream file{data.devPath + "/pp_od_clk_voltage"};
 		char cmdString[32];
 		snprintf(
 		    cmdString, 32, "%s %u %i %i", typeString, pointIndex, vfPoint->clock, target);
-
-		if (file << cmdString && file << "c")
-			return std::nullopt;
-		return AssignmentError::UnknownError;
-	};
-
-	auto setWithPerfLevel = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
-		return withManualPerformanceLevel(setFunc, a, data);
+		return writeODCommand(cmdString, data);
 	};
 
-	return Assignable{setWithPerfLevel, range, getFunc, _("mV")};
+	return odAssignable(setFunc, range, getFunc, _("mV"), data);
 }
 
 std::vector<TreeNode<DeviceNode>> getTemperature(AMDGPUData data) {
 	auto func = [=]() -> ReadResult {
 		uint temp;
 		// Always uses uintptr_t to write return data
-		if (amdgpu_query_sensor_info(
-			data.devHandle, AMDGPU_INFO_SENSOR_GPU_TEMP, sizeof(temp), &temp) == 0)
+		if (querySensorInfo(data, AMDGPU_INFO_SENSOR_GPU_TEMP, sizeof(temp), &temp) == 0)
 			return temp / 1000;
 		return ReadError::UnknownError;
 	};
 
-	DynamicReadable dr{func, _("°C")};
+	DynamicReadable dr{func, _("°C"), {.volatility = Volatility::Low}};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Temperature"), func)) {
 		return {DeviceNode{
 		    .name = _("Temperature"),
 		    .interface = dr,
@@ -325,12 +337,12 @@ std::vector<TreeNode<DeviceNode>> getFanMode(AMDGPUData data) {
 	// Don't try to use pre-6.7 interface on RX 7000
 	char fanCurvePath[128];
 	snprintf(fanCurvePath, 128, "%s/gpu_od/fan_ctrl/fan_curve", data.devPath.c_str());
-	if (std::ifstream{fanCurvePath}.good())
+	if (std::ifstream{fsPath(fanCurvePath)}.good())
 		return {};
 
 	char path[96];
 	snprintf(path, 96, "%s/pwm1_enable", data.hwmonPath.c_str());
-	if (!std::ifstream{path}.good())
+	if (!std::ifstream{fsPath(path)}.good())
 		return {};
 
 	// TODO: does everything correctly handle enumerations that don't start at zero?
@@ -359,7 +371,7 @@ std::vector<TreeNode<DeviceNode>> getFanMode(AMDGPUData data) {
 		if (!hasEnum(value, enumVec))
 			return AssignmentError::OutOfRange;
 
-		if (std::ofstream{path} << "2")
+		if (std::ofstream{fsPath(path)} << "2")
 			return std::nullopt;
 		return AssignmentError::UnknownError;
 	};
@@ -376,7 +388,7 @@ std::vector<TreeNode<DeviceNode>> getFanMode(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getFanModeRX7000(AMDGPUData data) {
 	char fanCurvePath[128];
 	snprintf(fanCurvePath, 128, "%s/gpu_od/fan_ctrl/fan_curve", data.devPath.c_str());
-	if (!std::ifstream{fanCurvePath}.good())
+	if (!std::ifstream{fsPath(fanCurvePath)}.good())
 		return {};
 
 	// This isn't really a range of options,
@@ -394,7 +406,7 @@ std::vector<TreeNode<DeviceNode>> getFanModeRX7000(AMDGPUData data) {
 		if (!hasEnum(target, enums))
 			return AssignmentError::OutOfRange;
 
-		std::ofstream file{fanCurvePath};
+		std::ofstream file{fsPath(fanCurvePath)};
 		if (file.good() && file << "r")
 			return std::nullopt;
 		return AssignmentError::UnknownError;
@@ -412,12 +424,12 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedWrite(AMDGPUData data) {
 	// TODO: potential regression, if this exists on older cards, but doesn't function
 	char fanCurvePath[128];
 	snprintf(fanCurvePath, 128, "%s/gpu_od/fan_ctrl/fan_curve", data.devPath.c_str());
-	if (std::ifstream{fanCurvePath}.good())
+	if (std::ifstream{fsPath(fanCurvePath)}.good())
 		return {};
 
 	char path[96];
 	snprintf(path, 96, "%s/pwm1", data.hwmonPath.c_str());
-	if (!std::ifstream{path}.good())
+	if (!std::ifstream{fsPath(path)}.good())
 		return {};
 
 	Range<int> range{0, 100};
@@ -443,7 +455,7 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedWrite(AMDGPUData data) {
 		// % -> PWM value (0-255)
 		auto ratio = static_cast<double>(value) / 100;
 		uint target = std::floor(ratio * 255);
-		if (std::ofstream{path} << target)
+		if (std::ofstream{fsPath(path)} << target)
 			return std::nullopt;
 		return AssignmentError::UnknownError;
 	};
@@ -460,7 +472,7 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedWrite(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getFanSpeedWriteRX7000(AMDGPUData data) {
 	char fanCurvePath[128];
 	snprintf(fanCurvePath, 128, "%s/gpu_od/fan_ctrl/fan_curve", data.devPath.c_str());
-	if (!std::ifstream{fanCurvePath}.good())
+	if (!std::ifstream{fsPath(fanCurvePath)}.good())
 		return {};
 
 	auto contents = fileContents(fanCurvePath);
@@ -487,7 +499,7 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedWriteRX7000(AMDGPUData data) {
 			return AssignmentError::OutOfRange;
 
 		// Write all curve points to same value
-		std::ofstream file{fanCurvePath};
+		std::ofstream file{fsPath(fanCurvePath)};
 		for (int i = 0; i < pointCount; i++) {
 			char cmdString[32];
 			// TODO: docs say PWM but internet says percentage
@@ -532,7 +544,7 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedRead(AMDGPUData data) {
 
 	DynamicReadable dr{func, _("%")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.identifier + "Fan Speed Read"), func))
 		return {DeviceNode{
 		    .name = _("Fan Speed"),
 		    .interface = dr,
@@ -581,7 +593,7 @@ std::vector<TreeNode<DeviceNode>> getPowerLimit(AMDGPUData data) {
 
 		// W -> uW
 		auto target = std::round(value * 1000000);
-		if (std::ofstream{path} << target)
+		if (std::ofstream{fsPath(path)} << target)
 			return std::nullopt;
 		return AssignmentError::UnknownError;
 	};
@@ -598,7 +610,7 @@ std::vector<TreeNode<DeviceNode>> getPowerLimit(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getPowerUsage(AMDGPUData data) {
 	auto func = [=]() -> ReadResult {
 		uint power;
-		if (amdgpu_query_sensor_info(data.devHandle, AMDGPU_INFO_SENSOR_GPU_AVG_POWER,
+		if (querySensorInfo(data, AMDGPU_INFO_SENSOR_GPU_AVG_POWER,
 			sizeof(power), &power) == 0)
 			return power;
 		return ReadError::UnknownError;
@@ -606,7 +618,7 @@ std::vector<TreeNode<DeviceNode>> getPowerUsage(AMDGPUData data) {
 
 	DynamicReadable dr{func, _("W")};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Power Usage"), func)) {
 		return {DeviceNode{
 		    .name = _("Power Usage"),
 		    .interface = dr,
@@ -619,15 +631,14 @@ std::vector<TreeNode<DeviceNode>> getPowerUsage(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getCoreClockRead(AMDGPUData data) {
 	auto func = [=]() -> ReadResult {
 		uint clock;
-		if (amdgpu_query_sensor_info(
-			data.devHandle, AMDGPU_INFO_SENSOR_GFX_SCLK, sizeof(clock), &clock) == 0)
+		if (querySensorInfo(data, AMDGPU_INFO_SENSOR_GFX_SCLK, sizeof(clock), &clock) == 0)
 			return clock;
 		return ReadError::UnknownError;
 	};
 
 	DynamicReadable dr{func, _("MHz")};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Core Clock"), func)) {
 		return {DeviceNode{
 		    .name = _("Core Clock"),
 		    .interface = dr,
@@ -641,15 +652,14 @@ std::vector<TreeNode<DeviceNode>> getMemoryClockRead(AMDGPUData data) {
 	auto func = [=]() -> ReadResult {
 		uint clock;
 		// TODO: is this actually the clock speed or memory controller clock?
-		if (amdgpu_query_sensor_info(
-			data.devHandle, AMDGPU_INFO_SENSOR_GFX_MCLK, sizeof(clock), &clock) == 0)
+		if (querySensorInfo(data, AMDGPU_INFO_SENSOR_GFX_MCLK, sizeof(clock), &clock) == 0)
 			return clock;
 		return ReadError::UnknownError;
 	};
 
 	DynamicReadable dr{func, _("MHz")};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Memory Clock"), func)) {
 		return {DeviceNode{
 		    .name = _("Memory Clock"),
 		    .interface = dr,
@@ -660,15 +670,15 @@ std::vector<TreeNode<DeviceNode>> getMemoryClockRead(AMDGPUData data) {
 }
 
 std::vector<TreeNode<DeviceNode>> getVoltFreqFreq(AMDGPUData data) {
-	static amdgpu_device_handle latestDev = nullptr;
+	static std::string latestDev;
 	static int pointId = 0;
 	std::vector<TreeNode<DeviceNode>> retval = {};
 
-	if (data.devHandle != latestDev)
+	if (data.identifier != latestDev)
 		// Start from zero for new device
 		pointId = 0;
 
-	latestDev = data.devHandle;
+	latestDev = data.identifier;
 
 	// TODO: assuming range is the same for all points
 	auto range = parsePstateRangeLineWithRead("VDDC_CURVE_SCLK[0]", data);
@@ -696,15 +706,15 @@ std::vector<TreeNode<DeviceNode>> getVoltFreqFreq(AMDGPUData data) {
 }
 
 std::vector<TreeNode<DeviceNode>> getVoltFreqVolt(AMDGPUData data) {
-	static amdgpu_device_handle latestDev = nullptr;
+	static std::string latestDev;
 	static int pointId = 0;
 	std::vector<TreeNode<DeviceNode>> retval = {};
 
-	if (data.devHandle != latestDev)
+	if (data.identifier != latestDev)
 		// Start from zero for new device
 		pointId = 0;
 
-	latestDev = data.devHandle;
+	latestDev = data.identifier;
 
 	// TODO: assuming range is the same for all points
 	auto range = parsePstateRangeLineWithRead("VDDC_CURVE_VOLT[0]", data);
@@ -732,15 +742,15 @@ std::vector<TreeNode<DeviceNode>> getVoltFreqVolt(AMDGPUData data) {
 }
 
 std::vector<TreeNode<DeviceNode>> getCorePStateFreq(AMDGPUData data) {
-	static amdgpu_device_handle latestDev = nullptr;
+	static std::string latestDev;
 	static int pointId = 0;
 	std::vector<TreeNode<DeviceNode>> retval = {};
 
-	if (data.devHandle != latestDev)
+	if (data.identifier != latestDev)
 		// Start from zero for new device
 		pointId = 0;
 
-	latestDev = data.devHandle;
+	latestDev = data.identifier;
 
 	auto range = parsePstateRangeLineWithRead("SCLK", data);
 	if (!range.has_value()) {
@@ -765,15 +775,15 @@ std::vector<TreeNode<DeviceNode>> getCorePStateFreq(AMDGPUData data) {
 }
 
 std::vector<TreeNode<DeviceNode>> getCorePStateVolt(AMDGPUData data) {
-	static amdgpu_device_handle latestDev = nullptr;
+	static std::string latestDev;
 	static int pointId = 0;
 	std::vector<TreeNode<DeviceNode>> retval = {};
 
-	if (data.devHandle != latestDev)
+	if (data.identifier != latestDev)
 		// Start from zero for new device
 		pointId = 0;
 
-	latestDev = data.devHandle;
+	latestDev = data.identifier;
 
 	auto range = parsePstateRangeLineWithRead("VDDC", data);
 	if (!range.has_value()) {
@@ -798,15 +808,15 @@ std::vector<TreeNode<DeviceNode>> getCorePStateVolt(AMDGPUData data) {
 }
 
 std::vector<TreeNode<DeviceNode>> getMemoryPStateFreq(AMDGPUData data) {
-	static amdgpu_device_handle latestDev = nullptr;
+	static std::string latestDev;
 	static int pointId = 0;
 	std::vector<TreeNode<DeviceNode>> retval = {};
 
-	if (data.devHandle != latestDev)
+	if (data.identifier != latestDev)
 		// Start from zero for new device
 		pointId = 0;
 
-	latestDev = data.devHandle;
+	latestDev = data.identifier;
 
 	auto rangeController = parsePstateRangeLineWithRead("MCLK", data);
 	if (!rangeController.has_value()) {
@@ -836,15 +846,15 @@ std::vector<TreeNode<DeviceNode>> getMemoryPStateFreq(AMDGPUData data) {
 }
 
 std::vector<TreeNode<DeviceNode>> getMemoryPStateVolt(AMDGPUData data) {
-	static amdgpu_device_handle latestDev = nullptr;
+	static std::string latestDev;
 	static int pointId = 0;
 	std::vector<TreeNode<DeviceNode>> retval = {};
 
-	if (data.devHandle != latestDev)
+	if (data.identifier != latestDev)
 		// Start from zero for new device
 		pointId = 0;
 
-	latestDev = data.devHandle;
+	latestDev = data.identifier;
 
 	auto range = parsePstateRangeLineWithRead("VDDC", data);
 	if (!range.has_value()) {
@@ -950,7 +960,7 @@ std::vector<TreeNode<DeviceNode>> getMemoryPStateNodes(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getVoltageRead(AMDGPUData data) {
 	auto func = [=](int sensorType) -> ReadResult {
 		uint volt;
-		if (amdgpu_query_sensor_info(data.devHandle, sensorType, sizeof(volt), &volt) == 0)
+		if (querySensorInfo(data, sensorType, sizeof(volt), &volt) == 0)
 			return volt;
 		return ReadError::UnknownError;
 	};
@@ -996,7 +1006,7 @@ std::vector<TreeNode<DeviceNode>> getForcePerfLevel(AMDGPUData data) {
 
 	Assignable a{setFunc, performanceLevelEnumVec, getFunc, std::nullopt};
 
-	if (getFunc().has_value())
+	if (hasCurrentValue(md5(data.identifier + "Performance Parameter Control"), getFunc))
 		return {DeviceNode{
 		    .name = _("Performance Parameter Control"),
 		    .interface = std::nullopt,
@@ -1008,15 +1018,14 @@ std::vector<TreeNode<DeviceNode>> getForcePerfLevel(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getCoreUtilization(AMDGPUData data) {
 	auto func = [=]() -> ReadResult {
 		uint util;
-		if (amdgpu_query_sensor_info(
-			data.devHandle, AMDGPU_INFO_SENSOR_GPU_LOAD, sizeof(util), &util) == 0)
+		if (querySensorInfo(data, AMDGPU_INFO_SENSOR_GPU_LOAD, sizeof(util), &util) == 0)
 			return util;
 		return ReadError::UnknownError;
 	};
 
 	DynamicReadable dr{func, _("%")};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Core Utilization"), func)) {
 		return {DeviceNode{
 		    .name = _("Core Utilization"),
 		    .interface = dr,
@@ -1036,7 +1045,7 @@ std::vector<TreeNode<DeviceNode>> getMemoryUtilization(AMDGPUData data) {
 
 	DynamicReadable dr{func, _("%")};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Memory Utilization"), func)) {
 		return {DeviceNode{
 		    .name = _("Memory Utilization"),
 		    .interface = dr,
@@ -1240,19 +1249,12 @@ std::vector<TreeNode<DeviceNode>> getCoreVoltageOffset(AMDGPUData data) {
 		if (target < range.min || target > range.max)
 			return AssignmentError::OutOfRange;
 
-		std::ofstream file{path};
 		char cmdString[32];
 		snprintf(cmdString, 32, "vo %i", target);
-		if (file.good() && file << cmdString && file << "c")
-			return std::nullopt;
-		return AssignmentError::UnknownError;
-	};
-
-	auto setWithPerfLevel = [=](AssignmentArgument a) {
-		return withManualPerformanceLevel(setFunc, a, data);
+		return writeODCommand(cmdString, data);
 	};
 
-	Assignable a{setWithPerfLevel, range, getFunc, _("mV")};
+	auto a = odAssignable(setFunc, range, getFunc, _("mV"), data);
 
 	return {DeviceNode{
 	    .name = _("Core Voltage Offset"),
@@ -1264,8 +1266,7 @@ std::vector<TreeNode<DeviceNode>> getCoreVoltageOffset(AMDGPUData data) {
 std::vector<TreeNode<DeviceNode>> getUsedVram(AMDGPUData data) {
 	auto func = [=]() -> ReadResult {
 		uint usedBytes;
-		if (amdgpu_query_info(
-			data.devHandle, AMDGPU_INFO_VRAM_USAGE, sizeof(usedBytes), &usedBytes) != 0)
+		if (queryInfo(data, AMDGPU_INFO_VRAM_USAGE, sizeof(usedBytes), &usedBytes) != 0)
 			return ReadError::UnknownError;
 		// B -> MB
 		return usedBytes / 1000000;
@@ -1273,7 +1274,7 @@ std::vector<TreeNode<DeviceNode>> getUsedVram(AMDGPUData data) {
 
 	DynamicReadable dr{func, _("MB")};
 
-	if (hasReadableValue(func())) {
+	if (hasReadableValue(md5(data.identifier + "Used VRAM"), func)) {
 		return {DeviceNode{
 		    .name = _("Used Memory"),
 		    .interface = dr,
@@ -1285,8 +1286,7 @@ std::vector<TreeNode<DeviceNode>> getUsedVram(AMDGPUData data) {
 
 std::vector<TreeNode<DeviceNode>> getTotalVram(AMDGPUData data) {
 	drm_amdgpu_info_vram_gtt vramInfo;
-	if (amdgpu_query_info(data.devHandle, AMDGPU_INFO_VRAM_GTT, sizeof(vramInfo), &vramInfo) !=
-	    0)
+	if (queryInfo(data, AMDGPU_INFO_VRAM_GTT, sizeof(vramInfo), &vramInfo) != 0)
 		return {};
 
 	// B -> MB
@@ -1406,7 +1406,7 @@ std::vector<TreeNode<DeviceNode>> getGPUName(AMDGPUData data) {
 			}};
 	}
 #endif
-	auto name = amdgpu_get_marketing_name(data.devHandle);
+	auto name = data.devHandle ? amdgpu_get_marketing_name(data.devHandle.get()) : nullptr;
 	if (name) {
 		return {DeviceNode{
 		    .name = name,
@@ -1483,9 +1483,7 @@ class AMDPlugin : public DevicePlugin {
 public:
 	std::optional<InitializationError> initializationError() { return std::nullopt; }
 	TreeNode<DeviceNode> deviceRootNode();
-	~AMDPlugin();
-private:
-	std::vector<AMDGPUData> m_gpuDataVec;
+	std::vector<std::string> hotplugSubsystems() { return {"drm"}; }
 };
 
 TreeNode<DeviceNode> AMDPlugin::deviceRootNode() {
@@ -1495,19 +1493,21 @@ TreeNode<DeviceNode> AMDPlugin::deviceRootNode() {
 
 	TreeNode<DeviceNode> root;
 
+	// Called again after hotplug events. Handles are released with the trees that use them
 	auto dataVec = fromFilesystem();
-	m_gpuDataVec = dataVec;
 
-	for (auto &data : dataVec)
+	for (auto &data : dataVec) {
+		if (data.ppTableType.has_value()) {
+			// Copy without the transaction so it doesn't keep itself alive
+			auto odData = data;
+			data.odTransaction = std::make_shared<Transaction>(
+			    [=] { return setPerformanceLevel(3u, odData); },
+			    [=] { return commitOD(odData); });
+		}
 		constructTree(gpuTree, root, data);
+	}
 
 	return root;
 }
 
-AMDPlugin::~AMDPlugin() {
-	for (auto info : m_gpuDataVec) {
-		amdgpu_device_deinitialize(info.devHandle);
-	}
-}
-
 TUXCLOCKER_PLUGIN_EXPORT(AMDPlugin)
@@ -1,5 +1,7 @@
 #include "AMDUtils.hpp"
 
+#include <algorithm>
+#include <cerrno>
 #include <fcntl.h>
 #include <fplus/fplus.hpp>
 #include <unistd.h>
@@ -168,38 +170,35 @@ std::optional<PPTableType> fromPPTableContents(const std::string &contents) {
 	return std::nullopt;
 }
 
-std::optional<AMDGPUData> fromRenderDFile(const fs::directory_entry &entry) {
+// Eg. /sys/class/drm/renderD128/device/hwmon/hwmon1
+std::optional<std::string> hwmonPath(const std::string &devPath) {
+	auto hwmonDir = devPath + "/hwmon";
+	std::error_code ec;
+	for (const auto &entry : fs::directory_iterator(fsPath(hwmonDir), ec)) {
+		auto filename = entry.path().filename().string();
+		if (filename.find("hwmon") != std::string::npos)
+			return hwmonDir + "/" + filename;
+	}
+	return std::nullopt;
+}
+
+std::optional<AMDGPUData> fromRenderDFile(const fs::directory_entry &entry, int index) {
 	auto fd = open(entry.path().c_str(), O_RDONLY);
 	auto v_ptr = drmGetVersion(fd);
 	amdgpu_device_handle dev;
 	uint32_t m, n;
 	int devInitRetval = amdgpu_device_initialize(fd, &m, &n, &dev);
-	// We can have multiple devices with the same PCI id, hopefully
-	// this order is somewhat consistent
-	static int gpuIndex = 0;
+	std::shared_ptr<amdgpu_device> handle;
+	if (devInitRetval == 0)
+		handle = std::shared_ptr<amdgpu_device>(dev, amdgpu_device_deinitialize);
 	if (fd > 0 && v_ptr && devInitRetval == 0 &&
 	    std::string(v_ptr->name).find(_AMDGPU_NAME) != std::string::npos) {
 		// Device uses amdgpu
-		// Find hwmon path
-		std::ostringstream stream;
 		// Eg. renderD128
 		auto filename = entry.path().filename().string();
-		stream << "/sys/class/drm/" << filename << "/device/hwmon";
-
 		auto devPath = "/sys/class/drm/" + filename + "/device";
-		std::optional<std::string> hwmonPath = std::nullopt;
-		try {
-			for (const auto &entry : fs::directory_iterator(stream.str())) {
-				if (entry.path().filename().string().find("hwmon") !=
-				    std::string::npos) {
-					hwmonPath = entry.path().string();
-					break;
-				}
-			}
-		} catch (fs::filesystem_error &e) {
-			goto fail;
-		}
-		if (!hwmonPath.has_value())
+		auto hwmon = hwmonPath(devPath);
+		if (!hwmon.has_value())
 			goto fail;
 
 		// Get PCI id
@@ -213,14 +212,14 @@ std::optional<AMDGPUData> fromRenderDFile(const fs::directory_entry &entry) {
 		if (contents.has_value())
 			tableType = fromPPTableContents(*contents);
 
-		auto index = gpuIndex;
 		auto identifier = std::to_string(info.device_id) + std::to_string(index);
-		gpuIndex++;
+		// libdrm keeps its own duplicate of the file descriptor
+		close(fd);
 		drmFreeVersion(v_ptr);
 		return AMDGPUData{
-		    .hwmonPath = hwmonPath.value(),
+		    .hwmonPath = hwmon.value(),
 		    .devPath = devPath,
-		    .devHandle = dev,
+		    .devHandle = handle,
 		    .pciId = std::to_string(info.device_id),
 		    .deviceFilename = filename,
 		    .identifier = identifier,
@@ -233,13 +232,65 @@ fail:
 	return std::nullopt;
 }
 
+std::optional<AMDGPUData> fromRecordedDevice(const std::string &filename, int index) {
+	auto devPath = "/sys/class/drm/" + filename + "/device";
+	auto uevent = fileContents(devPath + "/uevent");
+	auto pciIdString = fileContents(devPath + "/device");
+	auto hwmon = hwmonPath(devPath);
+	if (!uevent.has_value() || uevent->find("DRIVER=" _AMDGPU_NAME) == std::string::npos ||
+	    !pciIdString.has_value() || !hwmon.has_value())
+		return std::nullopt;
+
+	// Eg. 0x73bf, same as the device id libdrm gives
+	int pciId;
+	try {
+		pciId = std::stoi(*pciIdString, nullptr, 16);
+	} catch (std::exception &e) {
+		return std::nullopt;
+	}
+
+	std::optional<PPTableType> tableType = std::nullopt;
+	auto contents = fileContents(devPath + "/pp_od_clk_voltage");
+	if (contents.has_value())
+		tableType = fromPPTableContents(*contents);
+
+	return AMDGPUData{
+	    .hwmonPath = hwmon.value(),
+	    .devPath = devPath,
+	    .devHandle = nullptr,
+	    .pciId = std::to_string(pciId),
+	    .deviceFilename = filename,
+	    .identifier = std::to_string(pciId) + std::to_string(index),
+	    .ppTableType = tableType,
+	};
+}
+
 std::vector<AMDGPUData> fromFilesystem() {
 	std::vector<AMDGPUData> retval;
+	if (!fsRoot().empty()) {
+		// Sorted so indices match the order of the render nodes on real hardware
+		std::vector<std::string> filenames;
+		std::error_code ec;
+		for (const auto &entry : fs::directory_iterator(fsPath("/sys/class/drm"), ec)) {
+			auto filename = entry.path().filename().string();
+			if (filename.find(DRM_RENDER_MINOR_NAME) != std::string::npos)
+				filenames.push_back(filename);
+		}
+		std::sort(filenames.begin(), filenames.end());
+		for (auto &filename : filenames) {
+			auto data = fromRecordedDevice(filename, retval.size());
+			if (data.has_value())
+				retval.push_back(data.value());
+		}
+		return retval;
+	}
 	// Iterate through files in GPU device folder and find which ones have amdgpu loaded
 	for (const auto &entry : fs::directory_iterator(DRM_DIR_NAME)) {
 		// Check if path contains 'renderD' so we don't create root nodes for 'cardX' too
 		if (entry.path().string().find(DRM_RENDER_MINOR_NAME) != std::string::npos) {
-			auto data = fromRenderDFile(entry);
+			// We can have multiple devices with the same PCI id, hopefully
+			// this order is somewhat consistent
+			auto data = fromRenderDFile(entry, retval.size());
 			if (data.has_value())
 				retval.push_back(data.value());
 		}
@@ -247,9 +298,21 @@ std::vector<AMDGPUData> fromFilesystem() {
 	return retval;
 }
 
+int querySensorInfo(const AMDGPUData &data, unsigned sensor, unsigned size, void *value) {
+	if (!data.devHandle)
+		return -ENODEV;
+	return amdgpu_query_sensor_info(data.devHandle.get(), sensor, size, value);
+}
+
+int queryInfo(const AMDGPUData &data, unsigned query, unsigned size, void *value) {
+	if (!data.devHandle)
+		return -ENODEV;
+	return amdgpu_query_info(data.devHandle.get(), query, size, value);
+}
+
 int toMemoryClock(int controllerClock, AMDGPUData data) {
 	drm_amdgpu_info_device info;
-	if (amdgpu_query_info(data.devHandle, AMDGPU_INFO_DEV_INFO, sizeof(info), &info) != 0)
+	if (queryInfo(data, AMDGPU_INFO_DEV_INFO, sizeof(info), &info) != 0)
 		return controllerClock;
 
 	// For GDDR 6 (?) memory clock is 2x controller clock, for rest it's the same
@@ -261,7 +324,7 @@ int toMemoryClock(int controllerClock, AMDGPUData data) {
 
 int toControllerClock(int memoryClock, AMDGPUData data) {
 	drm_amdgpu_info_device info;
-	if (amdgpu_query_info(data.devHandle, AMDGPU_INFO_DEV_INFO, sizeof(info), &info) != 0)
+	if (queryInfo(data, AMDGPU_INFO_DEV_INFO, sizeof(info), &info) != 0)
 		return memoryClock;
 
 	if (info.vram_type == AMDGPU_VRAM_TYPE_GDDR6)
@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <libdrm/amdgpu.h>
 #include <libdrm/amdgpu_drm.h>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -28,7 +29,9 @@ struct AMDGPUData {
 	// Device path, eg. /sys/class/drm/renderD128/device
 	// Contains pp_od_clk_voltage and some others
 	std::string devPath;
-	amdgpu_device_handle devHandle;
+	// Deinitialized when the last copy is gone, eg. when the tree of the device is replaced
+	// after a rescan. Null for recorded devices
+	std::shared_ptr<amdgpu_device> devHandle;
 	// PCIe device ID
 	std::string pciId;
 	// Eg. renderD128
@@ -36,6 +39,8 @@ struct AMDGPUData {
 	// Device ID + GPU index
 	std::string identifier;
 	std::optional<PPTableType> ppTableType;
+	// Commits the changes staged to pp_od_clk_voltage in a batch
+	std::shared_ptr<TuxClocker::Device::Transaction> odTransaction;
 };
 
 std::vector<std::string> pstateSectionLines(const std::string &header, const std::string &contents);
@@ -62,10 +67,21 @@ std::optional<VFPoint> vfPointWithRead(const std::string &section, int index, AM
 
 std::optional<PPTableType> fromPPTableContents(const std::string &contents);
 
-std::optional<AMDGPUData> fromRenderDFile(const fs::directory_entry &entry);
+std::optional<std::string> hwmonPath(const std::string &devPath);
 
+// 'index' tells apart devices with the same PCI id
+std::optional<AMDGPUData> fromRenderDFile(const fs::directory_entry &entry, int index);
+
+// For files recorded from another machine, which have no render node to query
+std::optional<AMDGPUData> fromRecordedDevice(const std::string &filename, int index);
+
+// Finds devices from recorded sysfs files when TUXCLOCKER_FS_ROOT is set
 std::vector<AMDGPUData> fromFilesystem();
 
+// Same as the libdrm functions, but fail with -ENODEV for recorded devices
+int querySensorInfo(const AMDGPUData &data, unsigned sensor, unsigned size, void *value);
+int queryInfo(const AMDGPUData &data, unsigned query, unsigned size, void *value);
+
 // https://docs.kernel.org/gpu/amdgpu/thermal.html#pp-od-clk-voltage
 int toMemoryClock(int controllerClock, AMDGPUData data);
 int toControllerClock(int memoryClock, AMDGPUData data);
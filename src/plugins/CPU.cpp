@@ -4,6 +4,7 @@
 #include <fplus/fplus.hpp>
 #include <fstream>
 #include <libintl.h>
+#include <mutex>
 #include <Plugin.hpp>
 #include <regex>
 #include <sys/time.h>
@@ -50,6 +51,10 @@ struct CPUTimeStat {
 	uint64_t idleTime;
 };
 
+// Power is averaged between reads, over shorter periods it's mostly noise from the counter
+// update rate
+const SamplingHints energyCounterHints{.minimumInterval = std::chrono::milliseconds{100}};
+
 // Used to calculate power usage
 struct EnergyState {
 	uint64_t counter;
@@ -57,6 +62,9 @@ struct EnergyState {
 };
 
 uint utilizationPercentage(CPUTimeStat stat) {
+	// No ticks between two reads close together
+	if (stat.totalTime == 0)
+		return 0;
 	auto idle = static_cast<double>(stat.idleTime) / static_cast<double>(stat.totalTime);
 	auto active = 1 - idle;
 	return std::round(active * 100);
@@ -84,7 +92,7 @@ std::optional<uint64_t> readMsr(uint64_t address, uint64_t mask, uint coreIndex)
 	char path[32];
 	snprintf(path, 32, "/dev/cpu/%u/msr", coreIndex);
 
-	int msr_fd = open(path, O_RDONLY);
+	int msr_fd = open(fsPath(path).c_str(), O_RDONLY);
 	if (msr_fd < 0)
 		return std::nullopt;
 
@@ -210,13 +218,13 @@ std::vector<CPUInfoData> parseCPUInfo() {
 
 // TODO: this might be useful for other hwmon stuff too
 std::optional<std::string> coretempHwmonPath() {
-	auto hwmonDirs = std::filesystem::directory_iterator("/sys/class/hwmon");
+	auto hwmonDirs = std::filesystem::directory_iterator(fsPath("/sys/class/hwmon"));
 	for (auto &dir : hwmonDirs) {
 		// See if 'name' file contains 'coretemp'
-		auto namePath = dir.path().string() + "/name";
-		auto contents = fileContents(namePath);
+		auto path = "/sys/class/hwmon/" + dir.path().filename().string();
+		auto contents = fileContents(path + "/name");
 		if (contents.has_value() && contents->find("coretemp") != std::string::npos)
-			return dir.path().string();
+			return path;
 	}
 	return std::nullopt;
 }
@@ -225,7 +233,7 @@ std::optional<DynamicReadable> frequencyReadable(uint coreIndex) {
 	char path[64];
 	snprintf(path, 64, "/sys/devices/system/cpu/cpu%u/cpufreq/scaling_cur_freq", coreIndex);
 
-	std::ifstream file{path};
+	std::ifstream file{fsPath(path)};
 	if (!file.good())
 		return std::nullopt;
 
@@ -239,7 +247,8 @@ std::optional<DynamicReadable> frequencyReadable(uint coreIndex) {
 		return value / 1000;
 	};
 
-	return DynamicReadable{func, _("MHz")};
+	SamplingHints hints{.cost = ReadCost::Cheap, .volatility = Volatility::High};
+	return DynamicReadable{func, _("MHz"), hints};
 }
 
 std::optional<DynamicReadable> coretempReadable(const char *hwmonPath, uint index) {
@@ -257,12 +266,13 @@ std::optional<DynamicReadable> coretempReadable(const char *hwmonPath, uint inde
 	};
 
 	if (hasReadableValue(func()))
-		return DynamicReadable{func, _("°C")};
+		return DynamicReadable{
+		    func, _("°C"), {.cost = ReadCost::Cheap, .volatility = Volatility::Low}};
 	return std::nullopt;
 }
 
 std::vector<CPUTimeStat> readCPUStatsFromRange(uint minId, uint maxId) {
-	std::ifstream stat{"/proc/stat"};
+	std::ifstream stat{fsPath("/proc/stat")};
 	if (!stat.good())
 		return {};
 
@@ -296,6 +306,9 @@ CPUTimeStat timeStatDelta(CPUTimeStat prev, CPUTimeStat cur) {
 std::vector<uint> utilizationsFromRange(uint minId, uint maxId) {
 	// Saves the sample so we can compare to it on the next call
 	static std::unordered_map<uint, CPUTimeStat> timeStatMap;
+	// The daemon may read different CPUs concurrently
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock{mutex};
 
 	auto newTimeStats = readCPUStatsFromRange(minId, maxId);
 	if (newTimeStats.empty())
@@ -339,7 +352,7 @@ std::vector<TreeNode<DeviceNode>> getIntelEPBNodes(CPUData data) {
 	for (uint i = data.firstCoreIndex; i < data.firstCoreIndex + data.coreCount; i++) {
 		char path[96];
 		snprintf(path, 96, "/sys/devices/system/cpu/cpu%u/power/energy_perf_bias", i);
-		std::ifstream file{path};
+		std::ifstream file{fsPath(path)};
 		if (!file.good())
 			continue;
 
@@ -351,7 +364,7 @@ std::vector<TreeNode<DeviceNode>> getIntelEPBNodes(CPUData data) {
 		};
 
 		auto setFunc = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
-			std::ofstream file{path};
+			std::ofstream file{fsPath(path)};
 			if (!file.good())
 				return AssignmentError::UnknownError;
 
@@ -467,44 +480,41 @@ std::vector<TreeNode<DeviceNode>> getFreqs(CPUData data) {
 	return retval;
 }
 
-ReadResult utilizationBuffered(CPUData data, uint coreId) {
-	// NOTE: relies on the looping order in getUtilizations going from low to high
-	// Use cached results until we fetch for the first core id again
-	static std::unordered_map<uint, std::vector<uint>> cachedUtils;
-
-	auto vectorIndex = coreId - data.firstCoreIndex;
-	auto lastId = data.firstCoreIndex + data.coreCount - 1;
-	if (cachedUtils.find(data.cpuIndex) != cachedUtils.end()) {
-		// Cache has value
-		auto utils = cachedUtils[data.cpuIndex];
-		// Position relative to CPU
-		if (coreId == lastId) {
-			// Remove from map so we retrieve new value next time
-			cachedUtils.erase(data.cpuIndex);
-		}
-		return utils[vectorIndex];
-	}
-
-	auto utils = utilizationsFromRange(data.firstCoreIndex, lastId);
-	if (utils.empty())
-		return ReadError::UnknownError;
-
-	cachedUtils.insert({data.cpuIndex, utils});
-	return utils[vectorIndex];
-}
-
 std::vector<TreeNode<DeviceNode>> getUtilizations(CPUData data) {
 	std::vector<TreeNode<DeviceNode>> retval;
+	// All cores from one read of /proc/stat. Counted in USER_HZ ticks so shorter intervals
+	// between reads are inaccurate
+	auto lastId = data.firstCoreIndex + data.coreCount - 1;
+	// Saves the counters the first sampled read is compared to, and is what the cores are
+	// probed with. Read outside the group so its first pass is a new one
+	auto primed = utilizationsFromRange(data.firstCoreIndex, lastId);
+	auto group = std::make_shared<ReadableGroup>(
+	    [=] {
+		    std::vector<ReadResult> results;
+		    for (auto utilization : utilizationsFromRange(data.firstCoreIndex, lastId))
+			    results.push_back(utilization);
+		    return results;
+	    },
+	    std::chrono::milliseconds{100});
 	for (uint i = data.firstCoreIndex; i < data.firstCoreIndex + data.coreCount; i++) {
-		auto func = [=]() -> ReadResult { return utilizationBuffered(data, i); };
+		auto func = [&, index = i - data.firstCoreIndex]() -> ReadResult {
+			if (index >= primed.size())
+				return ReadError::UnknownError;
+			return primed[index];
+		};
 
-		if (hasReadableValue(func())) {
-			char idStr[64];
+		char idStr[64];
+		snprintf(idStr, 64, "%sCore%uUtilization", data.identifier.c_str(), i);
+		if (hasReadableValue(md5(idStr), func)) {
 			char name[32];
-			snprintf(idStr, 64, "%sCore%uUtilization", data.identifier.c_str(), i);
 			snprintf(name, 32, "%s %u", _("Core"), i);
 
-			DynamicReadable dr{func, _("%")};
+			// Reading /proc/stat is shared between the cores, but still a lot of
+			// parsing
+			auto dr = group->member(i - data.firstCoreIndex, _("%"),
+			    {.minimumInterval = std::chrono::milliseconds{100},
+				.cost = ReadCost::Expensive,
+				.volatility = Volatility::High});
 
 			DeviceNode node{
 			    .name = name,
@@ -519,6 +529,8 @@ std::vector<TreeNode<DeviceNode>> getUtilizations(CPUData data) {
 
 double energyCounterFactor(CPUData data) {
 	static std::unordered_map<uint, double> factors;
+	static std::mutex mutex;
+	std::lock_guard<std::mutex> lock{mutex};
 
 	if (factors.find(data.cpuIndex) == factors.end()) {
 		// No value yet
@@ -570,6 +582,8 @@ std::vector<TreeNode<DeviceNode>> getTotalPowerUsage(CPUData data) {
 	auto func = [=]() -> ReadResult {
 		// Previous EnergyState for CPU index
 		static std::unordered_map<uint, EnergyState> prevStates;
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock{mutex};
 
 		// 32 bits
 		auto curState = getEnergyState(*msrAddress, 0xffffffff, data.firstCoreIndex);
@@ -579,7 +593,7 @@ std::vector<TreeNode<DeviceNode>> getTotalPowerUsage(CPUData data) {
 		if (prevStates.find(data.cpuIndex) == prevStates.end()) {
 			// No previous value
 			prevStates[data.cpuIndex] = *curState;
-			// This result shouldn't be seen since this is called at initialization
+			// Not seen by the daemon, the state is primed when the readable is created
 			return 0.0f;
 		}
 		auto prevState = prevStates[data.cpuIndex];
@@ -588,10 +602,12 @@ std::vector<TreeNode<DeviceNode>> getTotalPowerUsage(CPUData data) {
 		return toWatts(*curState, prevState, data);
 	};
 
-	if (!hasReadableValue(func()))
+	if (!hasReadableValue(md5(data.identifier + "Power Usage"), func))
 		return {};
+	// The probe isn't run when it's cached, and the first read needs a previous counter value
+	func();
 
-	DynamicReadable dr{func, _("W")};
+	DynamicReadable dr{func, _("W"), energyCounterHints};
 
 	return {DeviceNode{
 	    .name = _("Power Usage"),
@@ -607,6 +623,8 @@ std::vector<TreeNode<DeviceNode>> getDramPowerUsage(CPUData data) {
 	auto func = [=]() -> ReadResult {
 		// Previous EnergyState for CPU index
 		static std::unordered_map<uint, EnergyState> prevStates;
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock{mutex};
 
 		// MSR_DRAM_ENERGY_STATUS, 32 bits
 		auto curState = getEnergyState(0x619, 0xffffffff, data.firstCoreIndex);
@@ -616,7 +634,7 @@ std::vector<TreeNode<DeviceNode>> getDramPowerUsage(CPUData data) {
 		if (prevStates.find(data.cpuIndex) == prevStates.end()) {
 			// No previous value
 			prevStates[data.cpuIndex] = *curState;
-			// This result shouldn't be seen since this is called at initialization
+			// Not seen by the daemon, the state is primed when the readable is created
 			return 0.0f;
 		}
 		auto prevState = prevStates[data.cpuIndex];
@@ -625,10 +643,12 @@ std::vector<TreeNode<DeviceNode>> getDramPowerUsage(CPUData data) {
 		return toWatts(*curState, prevState, data);
 	};
 
-	if (!hasReadableValue(func()))
+	if (!hasReadableValue(md5(data.identifier + "DRAM Power Usage"), func))
 		return {};
+	// The probe isn't run when it's cached, and the first read needs a previous counter value
+	func();
 
-	DynamicReadable dr{func, _("W")};
+	DynamicReadable dr{func, _("W"), energyCounterHints};
 
 	return {DeviceNode{
 	    .name = _("Memory Power Usage"),
@@ -644,6 +664,8 @@ std::vector<TreeNode<DeviceNode>> getCorePowerUsage(CPUData data) {
 	auto func = [=]() -> ReadResult {
 		// Previous EnergyState for CPU index
 		static std::unordered_map<uint, EnergyState> prevStates;
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock{mutex};
 
 		// MSR_PP0_ENERGY_STATUS, 32 bits
 		auto curState = getEnergyState(0x639, 0xffffffff, data.firstCoreIndex);
@@ -653,7 +675,7 @@ std::vector<TreeNode<DeviceNode>> getCorePowerUsage(CPUData data) {
 		if (prevStates.find(data.cpuIndex) == prevStates.end()) {
 			// No previous value
 			prevStates[data.cpuIndex] = *curState;
-			// This result shouldn't be seen since this is called at initialization
+			// Not seen by the daemon, the state is primed when the readable is created
 			return 0.0f;
 		}
 		auto prevState = prevStates[data.cpuIndex];
@@ -662,10 +684,12 @@ std::vector<TreeNode<DeviceNode>> getCorePowerUsage(CPUData data) {
 		return toWatts(*curState, prevState, data);
 	};
 
-	if (!hasReadableValue(func()))
+	if (!hasReadableValue(md5(data.identifier + "Core Power Usage"), func))
 		return {};
+	// The probe isn't run when it's cached, and the first read needs a previous counter value
+	func();
 
-	DynamicReadable dr{func, _("W")};
+	DynamicReadable dr{func, _("W"), energyCounterHints};
 
 	return {DeviceNode{
 	    .name = _("Core Power Usage"),
@@ -723,7 +747,7 @@ std::vector<TreeNode<DeviceNode>> getGovernors(CPUData data) {
 		};
 
 		auto setFunc = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
-			std::ofstream file{curPath};
+			std::ofstream file{fsPath(curPath)};
 			if (!file.good())
 				return AssignmentError::UnknownError;
 
@@ -746,7 +770,7 @@ std::vector<TreeNode<DeviceNode>> getGovernors(CPUData data) {
 		char name[32];
 		snprintf(name, 32, "%s %u", _("Core"), i);
 
-		if (getFunc().has_value()) {
+		if (hasCurrentValue(md5(idStr), getFunc)) {
 			DeviceNode node{
 			    .name = name,
 			    .interface = a,
@@ -818,7 +842,7 @@ std::vector<TreeNode<DeviceNode>> getEPPNodes(CPUData data) {
 			if (!hasEnum(arg, enumVec))
 				return AssignmentError::OutOfRange;
 
-			std::ofstream file{path};
+			std::ofstream file{fsPath(path)};
 			if (file.good() && file << sysFsNames[arg])
 				return std::nullopt;
 			return AssignmentError::UnknownError;
@@ -831,7 +855,7 @@ std::vector<TreeNode<DeviceNode>> getEPPNodes(CPUData data) {
 		char name[32];
 		snprintf(name, 32, "%s %u", _("Core"), i);
 
-		if (getFunc().has_value()) {
+		if (hasCurrentValue(md5(idStr), getFunc)) {
 			DeviceNode node{
 			    .name = name,
 			    .interface = a,
@@ -894,7 +918,7 @@ std::vector<Assignable> freqLimitAssignableFromFormat(CPUData data, const char *
 			if (arg < range->min || arg > range->max)
 				return AssignmentError::OutOfRange;
 
-			std::ofstream file{path};
+			std::ofstream file{fsPath(path)};
 			// MHz -> kHz
 			if (file << (arg * 1000))
 				return std::nullopt;
@@ -964,7 +988,7 @@ std::vector<TreeNode<DeviceNode>> getCoreVoltage(CPUData data) {
 		// V -> mV
 		return (increment * factor) * 1000;
 	};
-	if (!hasReadableValue(func()))
+	if (!hasReadableValue(md5(data.identifier + "Core Voltage"), func))
 		return {};
 	// Normally this is shown in V, but we already have translations for mV
 	return {DeviceNode{
@@ -1136,6 +1160,8 @@ public:
 
 		return root;
 	}
+	// Onlining and offlining cores
+	std::vector<std::string> hotplugSubsystems() { return {"cpu"}; }
 	std::optional<InitializationError> initializationError() { return std::nullopt; }
 };
 
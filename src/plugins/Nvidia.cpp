@@ -326,7 +326,7 @@ std::vector<TreeNode<DeviceNode>> getCoreClockRead(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("MHz")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Core Clock"), func))
 		return {DeviceNode{
 		    .name = _("Core Clock"),
 		    .interface = dr,
@@ -347,7 +347,7 @@ std::vector<TreeNode<DeviceNode>> getMemClockRead(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("MHz")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Memory Clock"), func))
 		return {DeviceNode{
 		    .name = _("Memory Clock"),
 		    .interface = dr,
@@ -383,7 +383,7 @@ std::vector<TreeNode<DeviceNode>> getReservedVram(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("MB")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Reserved VRAM"), func))
 		return {DeviceNode{
 		    .name = _("Reserved Memory"),
 		    .interface = dr,
@@ -403,7 +403,7 @@ std::vector<TreeNode<DeviceNode>> getUsedVram(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("MB")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Used VRAM"), func))
 		return {DeviceNode{
 		    .name = _("Used Memory"),
 		    .interface = dr,
@@ -458,7 +458,7 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedRead(NvidiaGPUData data) {
 	DynamicReadable dr{func, _("%")};
 
 	fanId++;
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Fan Speed Read" + std::to_string(id)), func))
 		return {DeviceNode{
 		    .name = _("Fan Speed"),
 		    .interface = dr,
@@ -501,7 +501,7 @@ std::vector<TreeNode<DeviceNode>> getFanSpeedWrite(NvidiaGPUData data) {
 	Assignable a{setFunc, Range<int>{0, 100}, getFunc, _("%")};
 
 	fanId++;
-	if (getFunc().has_value())
+	if (hasCurrentValue(md5(data.uuid + "Fan Speed Write" + std::to_string(id)), getFunc))
 		return {DeviceNode{
 		    .name = _("Fan Speed"),
 		    .interface = a,
@@ -570,7 +570,7 @@ std::vector<TreeNode<DeviceNode>> getCoreUtilization(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("%")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Core Utilization"), func))
 		return {DeviceNode{
 		    .name = _("Core Utilization"),
 		    .interface = dr,
@@ -590,7 +590,7 @@ std::vector<TreeNode<DeviceNode>> getMemoryUtilization(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("%")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Memory Utilization"), func))
 		return {DeviceNode{
 		    .name = _("Memory Utilization"),
 		    .interface = dr,
@@ -624,9 +624,10 @@ std::vector<TreeNode<DeviceNode>> getPcieUtilization(NvidiaGPUData data) {
 		return ReadError::UnknownError;
 	};
 
-	DynamicReadable dr{func, _("%")};
+	// NVML measures the throughput for 20 ms in each call
+	DynamicReadable dr{func, _("%"), {.cost = ReadCost::Expensive}};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "PCIe Bandwidth Utilization"), func))
 		return {DeviceNode{
 		    .name = _("PCIe Bandwidth Utilization"),
 		    .interface = dr,
@@ -646,7 +647,7 @@ std::vector<TreeNode<DeviceNode>> getPowerUsage(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("W")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Power Usage"), func))
 		return {DeviceNode{
 		    .name = _("Power Usage"),
 		    .interface = dr,
@@ -703,9 +704,9 @@ std::vector<TreeNode<DeviceNode>> getTemperature(NvidiaGPUData data) {
 		return temp;
 	};
 
-	DynamicReadable dr{func, _("°C")};
+	DynamicReadable dr{func, _("°C"), {.volatility = Volatility::Low}};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Temperature"), func))
 		return {DeviceNode{
 		    .name = _("Temperature"),
 		    .interface = dr,
@@ -758,7 +759,7 @@ std::vector<TreeNode<DeviceNode>> getVoltage(NvidiaGPUData data) {
 
 	DynamicReadable dr{func, _("mV")};
 
-	if (hasReadableValue(func()))
+	if (hasReadableValue(md5(data.uuid + "Core Voltage"), func))
 		return {DeviceNode{
 		    .name = _("Core Voltage"),
 		    .interface = dr,
@@ -805,7 +806,7 @@ std::vector<TreeNode<DeviceNode>> getVoltageOffset(NvidiaGPUData data) {
 
 	Assignable a{setFunc, range, getFunc, _("mV")};
 
-	if (getFunc().has_value())
+	if (hasCurrentValue(md5(data.uuid + "Core Voltage Offset"), getFunc))
 		return {DeviceNode{
 		    .name = _("Core Voltage Offset"),
 		    .interface = a,
@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <Crypto.hpp>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <Plugin.hpp>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <TreeConstructor.hpp>
+
+/* Creates made up devices with as many nodes as wanted, for finding out how the daemon, D-Bus
+   and the GUI scale. Configured with comma separated key=value pairs in TUXCLOCKER_SYNTHETIC,
+   eg. TUXCLOCKER_SYNTHETIC="devices=100,readables=100,assignables=10,cost=200,spin=1"
+
+   devices	Number of devices, nothing is created when unset
+   readables	DynamicReadables per device
+   assignables	Assignables per device, ranging from 0 to 100
+   statics	StaticReadables per device
+   dynamics	How readable values change: 'random-walk', 'sine' or 'constant'
+   script	File of whitespace separated values readables repeat instead
+   cost		Microseconds a read takes
+   spin		Busy-wait instead of sleeping for the read cost when 1
+   async	Readables are asynchronous and complete after the read cost when 1
+   typed	Readables use a TypedReader instead of a std::function when 1 */
+
+using namespace TuxClocker;
+using namespace TuxClocker::Crypto;
+using namespace TuxClocker::Device;
+using namespace TuxClocker::Plugin;
+
+enum class Dynamics {
+	RandomWalk,
+	Sine,
+	Constant
+};
+
+struct SyntheticConfig {
+	int devices = 0;
+	int readables = 16;
+	int assignables = 4;
+	int statics = 4;
+	Dynamics dynamics = Dynamics::RandomWalk;
+	std::shared_ptr<std::vector<double>> script;
+	std::chrono::microseconds readCost{0};
+	bool spin = false;
+	bool async = false;
+	bool typed = false;
+};
+
+struct SyntheticData {
+	SyntheticConfig config;
+	std::string identifier;
+	int index;
+};
+
+std::optional<SyntheticConfig> parseConfig(const std::string &spec) {
+	SyntheticConfig config;
+	std::istringstream stream{spec};
+	std::string pair;
+	try {
+		while (std::getline(stream, pair, ',')) {
+			auto separator = pair.find('=');
+			if (separator == std::string::npos)
+				return std::nullopt;
+			auto key = pair.substr(0, separator);
+			auto value = pair.substr(separator + 1);
+
+			if (key == "devices")
+				config.devices = std::stoi(value);
+			else if (key == "readables")
+				config.readables = std::stoi(value);
+			else if (key == "assignables")
+				config.assignables = std::stoi(value);
+			else if (key == "statics")
+				config.statics = std::stoi(value);
+			else if (key == "cost")
+				config.readCost = std::chrono::microseconds{std::stoi(value)};
+			else if (key == "spin")
+				config.spin = std::stoi(value) != 0;
+			else if (key == "async")
+				config.async = std::stoi(value) != 0;
+			else if (key == "typed")
+				config.typed = std::stoi(value) != 0;
+			else if (key == "dynamics" && value == "random-walk")
+				config.dynamics = Dynamics::RandomWalk;
+			else if (key == "dynamics" && value == "sine")
+				config.dynamics = Dynamics::Sine;
+			else if (key == "dynamics" && value == "constant")
+				config.dynamics = Dynamics::Constant;
+			else if (key == "script") {
+				std::ifstream file{value};
+				config.script = std::make_shared<std::vector<double>>();
+				double scriptValue;
+				while (file >> scriptValue)
+					config.script->push_back(scriptValue);
+				if (config.script->empty())
+					return std::nullopt;
+			} else
+				return std::nullopt;
+		}
+	} catch (std::exception &e) {
+		return std::nullopt;
+	}
+	return config;
+}
+
+void simulateReadCost(const SyntheticConfig &config) {
+	if (config.readCost.count() == 0)
+		return;
+	if (!config.spin) {
+		std::this_thread::sleep_for(config.readCost);
+		return;
+	}
+	auto end = std::chrono::steady_clock::now() + config.readCost;
+	while (std::chrono::steady_clock::now() < end)
+		;
+}
+
+// Completes asynchronous reads when they're due, like a device answering queries later
+class ReplyQueue {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static ReplyQueue &instance() {
+		// Never destroyed, since the thread can't be joined when the plugin is unloaded
+		static auto queue = new ReplyQueue;
+		return *queue;
+	}
+	void push(Clock::time_point due, std::function<void()> reply) {
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_replies.emplace(due, std::move(reply));
+		}
+		m_condition.notify_one();
+	}
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::multimap<Clock::time_point, std::function<void()>> m_replies;
+
+	ReplyQueue() { std::thread{[this] { run(); }}.detach(); }
+	void run() {
+		std::unique_lock<std::mutex> lock{m_mutex};
+		while (true) {
+			if (m_replies.empty()) {
+				m_condition.wait(lock);
+				continue;
+			}
+			auto first = m_replies.begin();
+			if (first->first > Clock::now()) {
+				m_condition.wait_until(lock, first->first);
+				continue;
+			}
+			auto reply = std::move(first->second);
+			m_replies.erase(first);
+			lock.unlock();
+			reply();
+			lock.lock();
+		}
+	}
+};
+
+// Values of a readable, shared by the copies of its read function
+class ValueSource {
+public:
+	ValueSource(const SyntheticConfig &config, int index)
+	    : m_config(config), m_index(index), m_scriptIndex(index) {}
+	const SyntheticConfig &config() const { return m_config; }
+	std::optional<double> next() {
+		if (m_config.script)
+			return (*m_config.script)[m_scriptIndex++ % m_config.script->size()];
+
+		switch (m_config.dynamics) {
+		case Dynamics::RandomWalk: {
+			thread_local std::mt19937 generator{std::random_device{}()};
+			std::uniform_real_distribution<double> step{-1, 1};
+			auto value = std::clamp(m_state.load() + step(generator), 0.0, 100.0);
+			m_state.store(value);
+			return value;
+		}
+		case Dynamics::Sine: {
+			std::chrono::duration<double> time =
+			    std::chrono::steady_clock::now().time_since_epoch();
+			// 10 second period, readables are out of phase with each other
+			return 50 + 50 * std::sin(2 * M_PI * time.count() / 10 + m_index);
+		}
+		case Dynamics::Constant:
+			return m_state.load();
+		}
+		return std::nullopt;
+	}
+private:
+	SyntheticConfig m_config;
+	int m_index;
+	std::atomic<double> m_state{50};
+	std::atomic<size_t> m_scriptIndex;
+};
+
+// Sources of typed readers by context. Only added to while the tree is built, before reads
+std::deque<ValueSource> typedSources;
+
+bool readTyped(uint32_t context, double &value) {
+	auto &source = typedSources[context];
+	simulateReadCost(source.config());
+	auto next = source.next();
+	if (next.has_value())
+		value = *next;
+	return next.has_value();
+}
+
+DynamicReadable syntheticReadable(const SyntheticConfig &config, int index) {
+	if (config.typed) {
+		typedSources.emplace_back(config, index);
+		uint32_t context = typedSources.size() - 1;
+		return DynamicReadable{TypedReader<double>{readTyped, context}, "%"};
+	}
+	auto source = std::make_shared<ValueSource>(config, index);
+	auto value = [source]() -> ReadResult {
+		auto value = source->next();
+		if (!value.has_value())
+			return ReadError::UnknownError;
+		return *value;
+	};
+	if (config.async) {
+		auto asyncFunc = [=](Completion<ReadResult> done) {
+			ReplyQueue::instance().push(ReplyQueue::Clock::now() + config.readCost,
+			    [=] { done(value()); });
+		};
+		return DynamicReadable{asyncFunc, "%"};
+	}
+	auto func = [=]() -> ReadResult {
+		simulateReadCost(config);
+		return value();
+	};
+	return DynamicReadable{func, "%"};
+}
+
+Assignable syntheticAssignable() {
+	auto value = std::make_shared<std::atomic<int>>(50);
+	Range<int> range{0, 100};
+
+	auto setFunc = [=](AssignmentArgument a) -> std::optional<AssignmentError> {
+		if (!std::holds_alternative<int>(a))
+			return AssignmentError::InvalidType;
+
+		auto arg = std::get<int>(a);
+		if (arg < range.min || arg > range.max)
+			return AssignmentError::OutOfRange;
+
+		value->store(arg);
+		return std::nullopt;
+	};
+	auto getFunc = [=]() -> std::optional<AssignmentArgument> { return value->load(); };
+
+	return Assignable{setFunc, range, getFunc, "%"};
+}
+
+std::vector<TreeNode<DeviceNode>> getDeviceRoot(SyntheticData data) {
+	return {DeviceNode{
+	    .name = "Synthetic Device " + std::to_string(data.index),
+	    .interface = std::nullopt,
+	    .hash = md5(data.identifier),
+	}};
+}
+
+std::vector<TreeNode<DeviceNode>> getReadablesRoot(SyntheticData data) {
+	if (data.config.readables < 1)
+		return {};
+	return {DeviceNode{
+	    .name = "Readables",
+	    .interface = std::nullopt,
+	    .hash = md5(data.identifier + "Readables"),
+	}};
+}
+
+std::vector<TreeNode<DeviceNode>> getReadables(SyntheticData data) {
+	std::vector<TreeNode<DeviceNode>> retval;
+	for (int i = 0; i < data.config.readables; i++) {
+		auto name = "Readable " + std::to_string(i);
+		retval.push_back(DeviceNode{
+		    .name = name,
+		    .interface = syntheticReadable(data.config, i),
+		    .hash = md5(data.identifier + name),
+		});
+	}
+	return retval;
+}
+
+std::vector<TreeNode<DeviceNode>> getAssignablesRoot(SyntheticData data) {
+	if (data.config.assignables < 1)
+		return {};
+	return {DeviceNode{
+	    .name = "Assignables",
+	    .interface = std::nullopt,
+	    .hash = md5(data.identifier + "Assignables"),
+	}};
+}
+
+std::vector<TreeNode<DeviceNode>> getAssignables(SyntheticData data) {
+	std::vector<TreeNode<DeviceNode>> retval;
+	for (int i = 0; i < data.config.assignables; i++) {
+		auto name = "Assignable " + std::to_string(i);
+		retval.push_back(DeviceNode{
+		    .name = name,
+		    .interface = syntheticAssignable(),
+		    .hash = md5(data.identifier + name),
+		});
+	}
+	return retval;
+}
+
+std::vector<TreeNode<DeviceNode>> getStaticsRoot(SyntheticData data) {
+	if (data.config.statics < 1)
+		return {};
+	return {DeviceNode{
+	    .name = "Static Readables",
+	    .interface = std::nullopt,
+	    .hash = md5(data.identifier + "Static Readables"),
+	}};
+}
+
+std::vector<TreeNode<DeviceNode>> getStatics(SyntheticData data) {
+	std::vector<TreeNode<DeviceNode>> retval;
+	for (int i = 0; i < data.config.statics; i++) {
+		auto name = "Static Readable " + std::to_string(i);
+		retval.push_back(DeviceNode{
+		    .name = name,
+		    .interface = StaticReadable{i, std::nullopt},
+		    .hash = md5(data.identifier + name),
+		});
+	}
+	return retval;
+}
+
+// clang-format off
+auto syntheticTree = TreeConstructor<SyntheticData, DeviceNode>{
+	getDeviceRoot, {
+		{getReadablesRoot, {
+			{getReadables, {}}
+		}},
+		{getAssignablesRoot, {
+			{getAssignables, {}}
+		}},
+		{getStaticsRoot, {
+			{getStatics, {}}
+		}}
+	}
+};
+// clang-format on
+
+class SyntheticPlugin : public DevicePlugin {
+public:
+	SyntheticPlugin() {}
+	~SyntheticPlugin() {}
+	TreeNode<DeviceNode> deviceRootNode() {
+		TreeNode<DeviceNode> root{};
+
+		auto spec = std::getenv("TUXCLOCKER_SYNTHETIC");
+		if (!spec)
+			return root;
+
+		auto config = parseConfig(spec);
+		if (!config.has_value()) {
+			std::cerr << "Invalid TUXCLOCKER_SYNTHETIC: " << spec << "\n";
+			return root;
+		}
+		for (int i = 0; i < config->devices; i++) {
+			SyntheticData data{*config, "synthetic" + std::to_string(i), i};
+			constructTree<SyntheticData, DeviceNode>(syntheticTree, root, data);
+		}
+		return root;
+	}
+	std::optional<InitializationError> initializationError() { return std::nullopt; }
+};
+
+TUXCLOCKER_PLUGIN_EXPORT(SyntheticPlugin)
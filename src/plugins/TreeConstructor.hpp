@@ -11,10 +11,11 @@ template <typename In, typename Out> struct TreeConstructor {
 };
 
 template <typename In, typename Out>
-void constructTree(TreeConstructor<In, Out> consNode, TuxClocker::TreeNode<Out> &node, In in) {
+void constructTree(
+    const TreeConstructor<In, Out> &consNode, TuxClocker::TreeNode<Out> &node, In in) {
 	for (auto &newNode : consNode.nodesToAttach(in)) {
 		// Attach wanted child
-		node.appendChild(newNode);
+		node.appendChild(std::move(newNode));
 		for (auto &child : consNode.children)
 			// We need pointer since node.children() just gives a copy
 			constructTree(child, node.childrenPtr()->back(), in);
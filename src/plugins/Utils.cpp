@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <fplus/fplus.hpp>
 #include <fstream>
 #include <sstream>
@@ -14,8 +15,18 @@ bool hasReadableValue(TuxClocker::Device::ReadResult res) {
 	return std::holds_alternative<TuxClocker::Device::ReadableValue>(res);
 }
 
+const std::string &fsRoot() {
+	static const std::string root = [] {
+		auto env = std::getenv("TUXCLOCKER_FS_ROOT");
+		return env ? std::string{env} : std::string{};
+	}();
+	return root;
+}
+
+std::string fsPath(const std::string &path) { return fsRoot() + path; }
+
 std::optional<std::string> fileContents(const std::string &path) {
-	std::ifstream file{path};
+	std::ifstream file{fsPath(path)};
 	if (!file.good())
 		return std::nullopt;
 
@@ -1,11 +1,32 @@
 #pragma once
 
 #include <Device.hpp>
+#include <ProbeCache.hpp>
+#include <string>
 
 bool hasEnum(uint enum_, const TuxClocker::Device::EnumerationVec &enumVec);
 
 bool hasReadableValue(TuxClocker::Device::ReadResult res);
 
+// Same as hasReadableValue(func()), but 'func' isn't called when the result for the node with
+// hash 'key' is in the probe cache
+template <typename Func> bool hasReadableValue(const std::string &key, Func func) {
+	return TuxClocker::ProbeCache::probe(key, [&] { return hasReadableValue(func()); });
+}
+
+// Same as above for the current value function of an Assignable
+template <typename Func> bool hasCurrentValue(const std::string &key, Func func) {
+	return TuxClocker::ProbeCache::probe(key, [&] { return func().has_value(); });
+}
+
+// Directory used in place of '/' for /sys, /proc and /dev, set with TUXCLOCKER_FS_ROOT.
+// Empty when unset. Lets plugins run against files recorded with dev/snapshot-fs.sh
+const std::string &fsRoot();
+
+// Absolute path prefixed with the root above. Paths given to the functions below and kept in
+// device data don't include the root
+std::string fsPath(const std::string &path);
+
 std::optional<std::string> fileContents(const std::string &path);
 
 // Splits only on whitespace
@@ -0,0 +1,333 @@
+// Starts tuxclockerd on the session bus and measures it from the client side: time until the
+// device tree can be fetched with an empty and a filled probe cache, memory used after
+// registering the nodes, latency of 'value' and 'assign', and reads per second with concurrent
+// clients. Meant to run on a private bus with dbus-run-session, see meson.build. Assigns
+// values, so it only runs when TUXCLOCKER_PLUGIN_PATH contains just the synthetic plugin.
+// Prints the results as JSON, and writes them to the file given with --output.
+//
+// Results are compared to the ones in the file given with --baseline. If it doesn't exist, the
+// results are written to it, so a run of a build without a change can be compared to one with it.
+//
+// Usage: daemonbenchmark <path to tuxclockerd> [--output <file>] [--baseline <file>]
+//	[--calls <count>] [--duration <ms>]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <DBusTypes.hpp>
+#include <iostream>
+#include <optional>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusMetaType>
+#include <QDBusReply>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QThread>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TCDBus = TuxClocker::DBus;
+
+Q_DECLARE_METATYPE(TCDBus::DeviceNode)
+Q_DECLARE_METATYPE(TCDBus::FlatTreeNode<TCDBus::DeviceNode>)
+Q_DECLARE_METATYPE(TCDBus::Result<QDBusVariant>)
+Q_DECLARE_METATYPE(TCDBus::Result<int>)
+
+using Clock = std::chrono::steady_clock;
+using Microseconds = std::chrono::duration<double, std::micro>;
+using FlatTree = QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>;
+
+// Exit code for skipped tests
+constexpr int skipCode = 77;
+constexpr auto startupTimeout = std::chrono::seconds{60};
+const std::vector<int> clientCounts = {1, 10, 100};
+
+struct Options {
+	QString daemonPath;
+	std::optional<QString> outputPath;
+	std::optional<QString> baselinePath;
+	int calls = 1000;
+	std::chrono::milliseconds duration{2000};
+};
+
+std::optional<Options> parseOptions(const QStringList &args) {
+	Options options;
+	for (int i = 1; i < args.size(); i++) {
+		auto hasValue = i + 1 < args.size();
+		if (args[i] == "--output" && hasValue)
+			options.outputPath = args[++i];
+		else if (args[i] == "--baseline" && hasValue)
+			options.baselinePath = args[++i];
+		else if (args[i] == "--calls" && hasValue)
+			options.calls = std::max(args[++i].toInt(), 1);
+		else if (args[i] == "--duration" && hasValue)
+			options.duration = std::chrono::milliseconds{args[++i].toInt()};
+		else if (options.daemonPath.isEmpty())
+			options.daemonPath = args[i];
+		else
+			return std::nullopt;
+	}
+	if (options.daemonPath.isEmpty())
+		return std::nullopt;
+	return options;
+}
+
+// Real plugins would have their hardware settings changed by the assignments
+bool onlySyntheticPlugin() {
+	auto pluginPath = qEnvironmentVariable("TUXCLOCKER_PLUGIN_PATH");
+	if (pluginPath.isEmpty() || qEnvironmentVariableIsEmpty("TUXCLOCKER_SYNTHETIC"))
+		return false;
+	return QDir{pluginPath}.entryList(QDir::Files) == QStringList{"libsynthetic.so"};
+}
+
+// Percentiles of the durations
+QJsonObject latencyJson(std::vector<double> durations) {
+	std::sort(durations.begin(), durations.end());
+	auto percentile = [&](double p) {
+		auto rank = static_cast<size_t>(std::ceil(p * durations.size()));
+		return durations[std::max(rank, size_t{1}) - 1];
+	};
+	return {{"calls", static_cast<int>(durations.size())}, {"p50", percentile(0.5)},
+	    {"p90", percentile(0.9)}, {"p99", percentile(0.99)}, {"max", durations.back()}};
+}
+
+template <typename Func> std::vector<double> timeCalls(int count, Func func) {
+	std::vector<double> retval;
+	for (int i = 0; i < count; i++) {
+		auto start = Clock::now();
+		func();
+		retval.push_back(Microseconds{Clock::now() - start}.count());
+	}
+	return retval;
+}
+
+// Every client has its own bus connection and thread, and reads its readable as fast as it can
+double readsPerSecond(int clients, const QStringList &paths, std::chrono::milliseconds duration) {
+	std::atomic<long> reads{0};
+	std::vector<std::thread> threads;
+	auto deadline = Clock::now() + duration;
+
+	for (int i = 0; i < clients; i++) {
+		threads.emplace_back([&, i] {
+			auto name = QString{"client%1"}.arg(i);
+			auto bus = QDBusConnection::SessionBus;
+			{
+				auto conn = QDBusConnection::connectToBus(bus, name);
+				QDBusInterface iface{"org.tuxclocker", paths[i % paths.size()],
+				    "org.tuxclocker.DynamicReadable", conn};
+				long count = 0;
+				while (Clock::now() < deadline) {
+					iface.call("value");
+					count++;
+				}
+				reads += count;
+			}
+			QDBusConnection::disconnectFromBus(name);
+		});
+	}
+	auto start = Clock::now();
+	for (auto &thread : threads)
+		thread.join();
+	std::chrono::duration<double> elapsed = Clock::now() - start;
+	return reads / elapsed.count();
+}
+
+// VmRSS of a process, zero if it can't be read
+double residentKiB(qint64 pid) {
+	QFile status{QString{"/proc/%1/status"}.arg(pid)};
+	if (!status.open(QIODevice::ReadOnly))
+		return 0;
+	auto match = QRegularExpression{"VmRSS:\\s+(\\d+) kB"}.match(
+	    QString::fromUtf8(status.readAll()));
+	return match.hasMatch() ? match.captured(1).toDouble() : 0;
+}
+
+/* Starts the daemon and waits until it serves the device tree. Adds the startup time, the
+   resident memory at that point and what the daemon logged about registering the nodes to
+   'result'. The log is written to 'logPath' since it isn't read while waiting. */
+std::optional<FlatTree> startDaemon(QProcess &daemon, const Options &options,
+    const QString &cachePath, const QString &logPath, QJsonObject &result) {
+	daemon.setStandardOutputFile(QProcess::nullDevice());
+	daemon.setStandardErrorFile(logPath);
+	auto start = Clock::now();
+	daemon.start(options.daemonPath, {"--session-bus", "--probe-cache", cachePath});
+
+	// Poll until the daemon has registered its objects
+	QDBusInterface tuxclockerd(
+	    "org.tuxclocker", "/", "org.tuxclocker", QDBusConnection::sessionBus());
+	QDBusReply<FlatTree> tree;
+	while (Clock::now() - start < startupTimeout) {
+		tree = tuxclockerd.call("flatDeviceTree");
+		if (tree.isValid() || daemon.state() == QProcess::NotRunning)
+			break;
+		QThread::msleep(5);
+	}
+	std::chrono::duration<double, std::milli> startup = Clock::now() - start;
+	if (!tree.isValid()) {
+		std::cerr << "Couldn't get device tree: " << qPrintable(tree.error().message())
+			  << "\n";
+		return std::nullopt;
+	}
+	result["startupMilliseconds"] = startup.count();
+	result["residentKiB"] = residentKiB(daemon.processId());
+
+	// eg. 'registered 1234 nodes in 5.6 ms, using 789 KiB of heap'
+	QFile log{logPath};
+	log.open(QIODevice::ReadOnly);
+	QRegularExpression registered{"registered \\d+ nodes in ([\\d.]+) ms, using (-?\\d+) KiB"};
+	auto match = registered.match(QString::fromUtf8(log.readAll()));
+	if (match.hasMatch()) {
+		result["registrationMilliseconds"] = match.captured(1).toDouble();
+		result["registrationHeapKiB"] = match.captured(2).toDouble();
+	}
+	return tree.value();
+}
+
+void stopDaemon(QProcess &daemon) {
+	daemon.terminate();
+	daemon.waitForFinished();
+}
+
+// Prints the numbers found in both, eg. 'valueMicroseconds.p50: 120 -> 95 (-20.8%)'
+void printComparison(
+    const QJsonObject &baseline, const QJsonObject &current, const QString &prefix = "") {
+	for (auto it = current.begin(); it != current.end(); it++) {
+		auto key = prefix + it.key();
+		auto before = baseline.value(it.key());
+		auto after = it.value();
+		if (before.isObject() && after.isObject()) {
+			printComparison(before.toObject(), after.toObject(), key + ".");
+		} else if (before.isDouble() && after.isDouble() && before.toDouble() != 0) {
+			auto change = (after.toDouble() / before.toDouble() - 1) * 100;
+			std::cout << qPrintable(key) << ": " << before.toDouble()
+				  << " -> " << after.toDouble() << " (" << (change > 0 ? "+" : "")
+				  << change << "%)\n";
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	QCoreApplication app(argc, argv);
+	qDBusRegisterMetaType<TCDBus::DeviceNode>();
+	qDBusRegisterMetaType<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>();
+	qDBusRegisterMetaType<FlatTree>();
+	qDBusRegisterMetaType<TCDBus::Result<QDBusVariant>>();
+	qDBusRegisterMetaType<TCDBus::Result<int>>();
+
+	auto options = parseOptions(app.arguments());
+	if (!options.has_value()) {
+		std::cerr << "Usage: daemonbenchmark <path to tuxclockerd> [--output <file>] "
+			     "[--baseline <file>] [--calls <count>] [--duration <ms>]\n";
+		return 1;
+	}
+	auto conn = QDBusConnection::sessionBus();
+	if (!conn.isConnected()) {
+		std::cerr << "No session bus, run with dbus-run-session\n";
+		return skipCode;
+	}
+	if (!onlySyntheticPlugin()) {
+		std::cerr << "Set TUXCLOCKER_PLUGIN_PATH to a directory with only the synthetic "
+			     "plugin, and TUXCLOCKER_SYNTHETIC\n";
+		return skipCode;
+	}
+
+	// Probe cache and logs of this run only
+	QTemporaryDir directory;
+	auto cachePath = directory.filePath("probe-cache");
+	auto logPath = directory.filePath("tuxclockerd.log");
+	QJsonObject results, coldStart, warmStart;
+
+	// First start fills the probe cache
+	// The environment is fine from here on, so failures are errors instead of skips
+	QProcess coldDaemon;
+	auto coldTree = startDaemon(coldDaemon, *options, cachePath, logPath, coldStart);
+	stopDaemon(coldDaemon);
+	if (!coldTree.has_value())
+		return 1;
+	QProcess daemon;
+	auto tree = startDaemon(daemon, *options, cachePath, logPath, warmStart);
+	if (!tree.has_value()) {
+		stopDaemon(daemon);
+		return 1;
+	}
+	results["coldStart"] = coldStart;
+	results["warmStart"] = warmStart;
+
+	QStringList readables, assignables;
+	for (auto &f_node : *tree) {
+		if (f_node.value.interface == "org.tuxclocker.DynamicReadable")
+			readables.append(f_node.value.path);
+		if (f_node.value.interface == "org.tuxclocker.Assignable")
+			assignables.append(f_node.value.path);
+	}
+	if (readables.empty()) {
+		std::cerr << "No DynamicReadables to read\n";
+		stopDaemon(daemon);
+		return 1;
+	}
+	results["nodes"] = tree->size();
+	results["dynamicReadables"] = readables.size();
+	results["assignables"] = assignables.size();
+
+	QDBusInterface readable{
+	    "org.tuxclocker", readables.first(), "org.tuxclocker.DynamicReadable", conn};
+	// Starts sampling the readable
+	timeCalls(10, [&] { readable.call("value"); });
+	results["valueMicroseconds"] =
+	    latencyJson(timeCalls(options->calls, [&] { readable.call("value"); }));
+
+	QJsonObject throughput;
+	for (auto clients : clientCounts)
+		throughput[QString::number(clients)] =
+		    readsPerSecond(clients, readables, options->duration);
+	results["readsPerSecond"] = throughput;
+
+	// Assigns the current value of a synthetic assignable back
+	results["assignMicroseconds"] = QJsonValue::Null;
+	for (auto &path : assignables) {
+		QDBusInterface assignable{
+		    "org.tuxclocker", path, "org.tuxclocker.Assignable", conn};
+		QDBusReply<TCDBus::Result<QDBusVariant>> current = assignable.call("currentValue");
+		if (!current.isValid() || current.value().error)
+			continue;
+		QVariant arg;
+		arg.setValue(current.value().value);
+		results["assignMicroseconds"] = latencyJson(timeCalls(
+		    std::max(options->calls / 10, 1), [&] { assignable.call("assign", arg); }));
+		break;
+	}
+	stopDaemon(daemon);
+
+	auto output = results;
+	if (options->baselinePath.has_value()) {
+		QFile file{*options->baselinePath};
+		if (file.exists() && file.open(QIODevice::ReadOnly)) {
+			output["baseline"] = QJsonDocument::fromJson(file.readAll()).object();
+		} else if (file.open(QIODevice::WriteOnly)) {
+			file.write(QJsonDocument{results}.toJson());
+			std::cerr << "Wrote baseline to " << qPrintable(*options->baselinePath)
+				  << "\n";
+		}
+	}
+	auto json = QJsonDocument{output}.toJson();
+	std::cout << json.constData();
+	if (output.contains("baseline")) {
+		std::cout << "\nCompared to the baseline:\n";
+		printComparison(output["baseline"].toObject(), results);
+	}
+	if (options->outputPath.has_value()) {
+		QFile file{*options->outputPath};
+		if (file.open(QIODevice::WriteOnly))
+			file.write(json);
+	}
+	return 0;
+}
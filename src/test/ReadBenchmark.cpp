@@ -0,0 +1,83 @@
+// Compares reading all DynamicReadables with one 'value' call per node to a single 'readMany'
+// call. Needs a running daemon.
+
+#include <chrono>
+#include <DBusTypes.hpp>
+#include <iostream>
+#include <memory>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusMetaType>
+#include <QDBusReply>
+#include <vector>
+
+namespace TCDBus = TuxClocker::DBus;
+
+Q_DECLARE_METATYPE(TCDBus::DeviceNode)
+Q_DECLARE_METATYPE(TCDBus::FlatTreeNode<TCDBus::DeviceNode>)
+Q_DECLARE_METATYPE(TCDBus::Result<QDBusVariant>)
+Q_DECLARE_METATYPE(TCDBus::BatchValue)
+Q_DECLARE_METATYPE(TCDBus::ValueBatch)
+
+// Exit code for skipped tests
+constexpr int skipCode = 77;
+
+template <typename Func> double millisecondsPerRound(int rounds, Func func) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; i++)
+		func();
+	std::chrono::duration<double, std::milli> elapsed =
+	    std::chrono::steady_clock::now() - start;
+	return elapsed.count() / rounds;
+}
+
+int main(int argc, char **argv) {
+	QCoreApplication app(argc, argv);
+	qDBusRegisterMetaType<TCDBus::DeviceNode>();
+	qDBusRegisterMetaType<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>();
+	qDBusRegisterMetaType<QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>>();
+	qDBusRegisterMetaType<TCDBus::Result<QDBusVariant>>();
+	qDBusRegisterMetaType<TCDBus::BatchValue>();
+	qDBusRegisterMetaType<QVector<TCDBus::BatchValue>>();
+	qDBusRegisterMetaType<TCDBus::ValueBatch>();
+
+	int rounds = (argc > 1) ? std::atoi(argv[1]) : 100;
+
+	auto conn = QDBusConnection::systemBus();
+	QDBusInterface tuxclockerd("org.tuxclocker", "/", "org.tuxclocker", conn);
+	QDBusReply<QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>> reply =
+	    tuxclockerd.call("flatDeviceTree");
+	if (!reply.isValid()) {
+		std::cerr << "Couldn't get device tree: " << qPrintable(reply.error().message())
+			  << "\n";
+		return skipCode;
+	}
+
+	QStringList paths;
+	std::vector<std::unique_ptr<QDBusInterface>> ifaces;
+	for (auto &f_node : reply.value()) {
+		if (f_node.value.interface != "org.tuxclocker.DynamicReadable")
+			continue;
+		paths.append(f_node.value.path);
+		ifaces.push_back(std::make_unique<QDBusInterface>("org.tuxclocker",
+		    f_node.value.path, "org.tuxclocker.DynamicReadable", conn));
+	}
+	if (paths.empty()) {
+		std::cerr << "No DynamicReadables to read\n";
+		return skipCode;
+	}
+
+	auto perNode = millisecondsPerRound(rounds, [&] {
+		for (auto &iface : ifaces)
+			iface->call("value");
+	});
+	auto batched = millisecondsPerRound(rounds, [&] {
+		QDBusReply<TCDBus::ValueBatch> r = tuxclockerd.call("readMany", paths);
+	});
+
+	std::cout << paths.size() << " readables, " << rounds << " rounds\n";
+	std::cout << "value:    " << perNode << " ms/round (" << paths.size() << " calls)\n";
+	std::cout << "readMany: " << batched << " ms/round (1 call)\n";
+	return 0;
+}
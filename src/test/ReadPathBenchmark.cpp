@@ -0,0 +1,150 @@
+// Nanoseconds and allocations per read of a DynamicReadable through a std::function and through
+// a TypedReader, up to the SampleRecord the daemon stores. Reads return values from a table,
+// so the overhead of the read path is what's measured. Doesn't need a running daemon.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <Device.hpp>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <SampleRecord.hpp>
+#include <string>
+#include <vector>
+
+using namespace TuxClocker::Device;
+
+std::atomic<size_t> allocations{0};
+
+// Not inlined, so GCC doesn't warn about free() of memory from new
+[[gnu::noinline]] void *operator new(size_t size) {
+	allocations++;
+	if (auto ptr = std::malloc(size))
+		return ptr;
+	throw std::bad_alloc{};
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+// What the plugins capture in their read functions, eg. CPUData
+struct DeviceData {
+	std::string identifier;
+	std::string name;
+	std::string path;
+	uint index;
+};
+
+std::vector<double> values;
+
+bool readValue(uint32_t context, double &value) {
+	value = values[context];
+	return true;
+}
+
+using TuxClocker::SampleRecord;
+using TuxClocker::SampleType;
+
+// Like sampleFromReadResult in the daemon, with std::visit instead of mpark::patterns
+SampleRecord fromReadResult(const ReadResult &result, uint64_t timestamp) {
+	SampleRecord record{.timestamp = timestamp, .error = true,
+	    .value = static_cast<double>(ReadError::UnknownError)};
+	if (auto value = std::get_if<ReadableValue>(&result)) {
+		std::visit(
+		    [&](auto &v) {
+			    using T = std::decay_t<decltype(v)>;
+			    if constexpr (!std::is_same_v<T, std::string>) {
+				    record.error = false;
+				    record.type = static_cast<SampleType>(value->index());
+				    record.value = v;
+			    }
+		    },
+		    *value);
+	}
+	return record;
+}
+
+SampleRecord fromTypedReader(const TypedReadFunc &reader, uint64_t timestamp) {
+	return std::visit(
+	    [&](auto &typedReader) {
+		    typename std::decay_t<decltype(typedReader)>::Value value;
+		    if (!typedReader.read(value))
+			    return SampleRecord{.timestamp = timestamp, .error = true,
+				.value = static_cast<double>(ReadError::UnknownError)};
+		    return SampleRecord{.timestamp = timestamp,
+			.type = static_cast<SampleType>(reader.index()),
+			.value = static_cast<double>(value)};
+	    },
+	    reader);
+}
+
+struct Result {
+	double nanoseconds;
+	double allocations;
+	double sum;
+};
+
+template <typename F> Result measure(size_t reads, F read) {
+	double sum = 0;
+	auto before = allocations.load();
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < reads; i++)
+		sum += read(i).value;
+	std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+	return {time.count() / reads, static_cast<double>(allocations - before) / reads, sum};
+}
+
+int main() {
+	constexpr size_t readableCount = 1024;
+	constexpr size_t reads = 10000000;
+	std::vector<DynamicReadable> functionReadables, typedReadables;
+	std::vector<std::shared_ptr<DynamicReadable>> sharedReadables;
+	for (uint i = 0; i < readableCount; i++) {
+		values.push_back(i % 100);
+		DeviceData data{"cpu0", "AMD Ryzen 9 7950X 16-Core Processor",
+		    "/sys/devices/system/cpu/cpu" + std::to_string(i) + "/cpufreq", i};
+		functionReadables.push_back(
+		    DynamicReadable{[data]() -> ReadResult { return values[data.index]; }});
+		typedReadables.push_back(DynamicReadable{TypedReader<double>{readValue, i}});
+		sharedReadables.push_back(
+		    std::make_shared<DynamicReadable>(functionReadables.back()));
+	}
+
+	auto function = measure(reads, [&](size_t i) {
+		return fromReadResult(functionReadables[i % readableCount].read(), i);
+	});
+	// What copying the readable for reads with a deadline would cost
+	auto functionCopied = measure(reads, [&](size_t i) {
+		auto readable = functionReadables[i % readableCount];
+		return fromReadResult(readable.read(), i);
+	});
+	// The sampler shares the readable with reads with a deadline instead
+	auto functionShared = measure(reads, [&](size_t i) {
+		auto readable = sharedReadables[i % readableCount];
+		return fromReadResult(readable->read(), i);
+	});
+	auto typed = measure(reads, [&](size_t i) {
+		return fromTypedReader(*typedReadables[i % readableCount].typedReader(), i);
+	});
+	auto typedCopied = measure(reads, [&](size_t i) {
+		auto reader = *typedReadables[i % readableCount].typedReader();
+		return fromTypedReader(reader, i);
+	});
+
+	if (function.sum != typed.sum || functionCopied.sum != typedCopied.sum ||
+	    functionShared.sum != typed.sum) {
+		std::cerr << "Read paths return different values\n";
+		return 1;
+	}
+	auto print = [](const char *name, Result result) {
+		std::cout << name << ": " << result.nanoseconds << " ns/read, "
+			  << result.allocations << " allocations/read\n";
+	};
+	print("std::function", function);
+	print("std::function, copied", functionCopied);
+	print("std::function, shared", functionShared);
+	print("TypedReader", typed);
+	print("TypedReader, copied", typedCopied);
+	return 0;
+}
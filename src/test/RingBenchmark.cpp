@@ -0,0 +1,73 @@
+// Throughput of the telemetry ring with one writer and one reader in separate threads.
+// Doesn't need a running daemon.
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <TelemetryRing.hpp>
+#include <thread>
+#include <vector>
+
+using namespace TuxClocker::Telemetry;
+
+int main(int argc, char **argv) {
+	uint64_t recordCount = (argc > 1) ? std::atoll(argv[1]) : 50000000;
+	uint32_t capacity = (argc > 2) ? std::atoi(argv[2]) : 65536;
+	std::vector<std::string> paths{"/bench/a", "/bench/b", "/bench/c", "/bench/d"};
+
+	auto writer = RingWriter::create(paths, capacity);
+	auto fd = writer.has_value() ? writer->readOnlyFd() : std::nullopt;
+	if (!fd.has_value()) {
+		std::cerr << "Couldn't create the ring\n";
+		return 1;
+	}
+	auto reader = RingReader::open(*fd);
+	if (!reader.has_value()) {
+		std::cerr << "Couldn't open the ring\n";
+		return 1;
+	}
+
+	std::atomic<bool> done{false};
+	uint64_t received = 0;
+	uint64_t lost = 0;
+	uint64_t invalid = 0;
+	std::thread readerThread{[&] {
+		std::vector<RingRecord> records;
+		records.reserve(reader->capacity());
+		uint64_t expected = 0;
+		while (true) {
+			auto finished = done.load(std::memory_order_acquire);
+			records.clear();
+			lost += reader->read(records);
+			for (auto &record : records) {
+				// Values are the record numbers, so torn records would show up here
+				if (record.value < expected || record.timestamp != record.value)
+					invalid++;
+				expected = record.value + 1;
+			}
+			received += records.size();
+			if (finished)
+				return;
+		}
+	}};
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint64_t i = 0; i < recordCount; i++) {
+		writer->write(RingRecord{.timestamp = i,
+		    .index = static_cast<uint32_t>(i % paths.size()),
+		    .value = static_cast<double>(i)});
+	}
+	done.store(true, std::memory_order_release);
+	readerThread.join();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::cout << recordCount << " records, capacity " << reader->capacity() << "\n";
+	std::cout << recordCount / elapsed.count() / 1e6 << " M records/s written\n";
+	std::cout << received / elapsed.count() / 1e6 << " M records/s read, " << lost
+		  << " overwritten before reading\n";
+	if (invalid != 0 || received + lost != recordCount) {
+		std::cerr << invalid << " invalid records\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+// Time of converting device trees of 10k to 100k nodes to the flat layout sent over D-Bus and
+// back, and a check that the layout is the same as before conversion was made linear. Also
+// compares traversing TreeNodes by value with traversing a TreeArena, by time and allocations.
+// Doesn't need a running daemon.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <string>
+#include <Tree.hpp>
+#include <tuple>
+#include <vector>
+
+using namespace TuxClocker;
+
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocatedBytes{0};
+
+void *operator new(size_t size) {
+	allocations++;
+	allocatedBytes += size;
+	if (auto ptr = std::malloc(size))
+		return ptr;
+	throw std::bad_alloc{};
+}
+
+// Not inlined, so GCC doesn't warn about free() of memory from new
+[[gnu::noinline]] void operator delete(void *ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+// Strings and a function like the names, hashes and interfaces of device nodes
+struct Value {
+	std::string name;
+	std::string hash;
+	std::function<int()> read = [name = name] { return static_cast<int>(name.size()); };
+	bool operator==(const Value &other) const {
+		return name == other.name && hash == other.hash;
+	}
+};
+
+// 'devices' devices with groups of 'perGroup' nodes, like the plugins create
+TreeNode<Value> makeTree(int nodeCount, int perGroup = 16) {
+	TreeNode<Value> root;
+	int created = 1;
+	for (int d = 0; created < nodeCount; d++) {
+		TreeNode<Value> device{{"Device " + std::to_string(d), std::to_string(created)}};
+		created++;
+		for (int g = 0; g < 8 && created < nodeCount; g++) {
+			TreeNode<Value> group{
+			    {"Group " + std::to_string(g), std::to_string(created)}};
+			created++;
+			for (int n = 0; n < perGroup && created < nodeCount; n++) {
+				group.appendChild(
+				    Value{"Node " + std::to_string(n), std::to_string(created)});
+				created++;
+			}
+			device.appendChild(std::move(group));
+		}
+		root.appendChild(std::move(device));
+	}
+	return root;
+}
+
+void preorderByRef(TreeNode<Value> *node, std::function<void(TreeNode<Value> *)> func) {
+	func(node);
+	for (auto &child : *node->childrenPtr())
+		preorderByRef(&child, func);
+}
+
+// What toFlatTree() did before: a traversal of the whole tree to find the index of each child
+FlatTree<Value> previousToFlatTree(TreeNode<Value> &root) {
+	std::vector<FlatTreeNode<Value>> nodes;
+	preorderByRef(&root, [&](TreeNode<Value> *n) {
+		FlatTreeNode<Value> node;
+		node.value = n->value();
+		for (auto &child : *n->childrenPtr()) {
+			int j = 0, index = 0;
+			preorderByRef(&root, [&](TreeNode<Value> *m) {
+				if (m == &child)
+					index = j;
+				j++;
+			});
+			node.childIndices.push_back(index);
+		}
+		nodes.push_back(node);
+	});
+	return FlatTree<Value>{nodes};
+}
+
+bool equal(const FlatTree<Value> &a, const FlatTree<Value> &b) {
+	if (a.nodes.size() != b.nodes.size())
+		return false;
+	for (size_t i = 0; i < a.nodes.size(); i++) {
+		if (!(a.nodes[i].value == b.nodes[i].value) ||
+		    a.nodes[i].childIndices != b.nodes[i].childIndices)
+			return false;
+	}
+	return true;
+}
+
+// How DeviceRegistry used to walk plugin trees, copying the subtree of every node passed
+size_t traverseByValue(TreeNode<Value> node) {
+	size_t retval = node.value().hash.size();
+	for (auto child : node.children())
+		retval += traverseByValue(child);
+	return retval;
+}
+
+size_t traverseView(TreeView<Value> node) {
+	size_t retval = node.value().hash.size();
+	for (auto child : node.children())
+		retval += traverseView(child);
+	return retval;
+}
+
+template <typename F> double milliseconds(F func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+	    .count();
+}
+
+int main() {
+	auto small = makeTree(2000);
+	FlatTree<Value> flat, previous;
+	auto flattenTime = milliseconds([&] { flat = small.toFlatTree(); });
+	// Quadratic, so it's only run at this size
+	auto previousTime = milliseconds([&] { previous = previousToFlatTree(small); });
+	if (!equal(flat, previous) ||
+	    !equal(FlatTree<Value>::toTree(flat).toFlatTree(), flat)) {
+		std::cerr << "Flat tree layout changed\n";
+		return 1;
+	}
+	TreeArena<Value> smallArena{small};
+	if (!equal(smallArena.toFlatTree(), flat) ||
+	    !equal(smallArena.root().toTree().toFlatTree(), flat)) {
+		std::cerr << "Arena differs from tree\n";
+		return 1;
+	}
+	std::cout << "2000 nodes: toFlatTree " << flattenTime << " ms, previous toFlatTree "
+		  << previousTime << " ms\n";
+
+	for (auto nodeCount : {10000, 30000, 100000}) {
+		auto tree = makeTree(nodeCount);
+		FlatTree<Value> flatTree;
+		TreeNode<Value> rebuilt;
+		auto flattenTime = milliseconds([&] { flatTree = tree.toFlatTree(); });
+		auto copy = flatTree;
+		auto rebuildTime =
+		    milliseconds([&] { rebuilt = FlatTree<Value>::toTree(std::move(copy)); });
+		auto moveTime = milliseconds([&] { flatTree = std::move(rebuilt).toFlatTree(); });
+		std::cout << nodeCount << " nodes: toFlatTree " << flattenTime << " ms, toTree "
+			  << rebuildTime << " ms, toFlatTree from rvalue " << moveTime << " ms\n";
+	}
+
+	for (auto nodeCount : {10000, 100000}) {
+		auto tree = makeTree(nodeCount);
+		size_t byValueSum = 0, viewSum = 0;
+		auto count = [](auto func) {
+			auto before = allocations.load();
+			auto beforeBytes = allocatedBytes.load();
+			auto time = milliseconds(func);
+			return std::tuple{time, allocations - before, allocatedBytes - beforeBytes};
+		};
+		auto [byValueTime, byValueAllocs, byValueBytes] =
+		    count([&] { byValueSum = traverseByValue(tree); });
+		std::optional<TreeArena<Value>> arena;
+		auto [arenaTime, arenaAllocs, arenaBytes] =
+		    count([&] { arena.emplace(std::move(tree)); });
+		auto [viewTime, viewAllocs, viewBytes] =
+		    count([&] { viewSum = traverseView(arena->root()); });
+		if (byValueSum != viewSum) {
+			std::cerr << "Traversals differ\n";
+			return 1;
+		}
+		std::cout << nodeCount << " nodes: traversal by value " << byValueTime << " ms, "
+			  << byValueAllocs << " allocations, " << byValueBytes / 1024
+			  << " KiB\n  moving into arena " << arenaTime << " ms, " << arenaAllocs
+			  << " allocations, " << arenaBytes / 1024 << " KiB\n  traversal of arena "
+			  << viewTime << " ms, " << viewAllocs << " allocations, "
+			  << viewBytes / 1024 << " KiB\n";
+	}
+	return 0;
+}
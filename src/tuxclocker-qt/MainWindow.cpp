@@ -66,15 +66,16 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
 	FlatTree<TCDBus::DeviceNode> flatTree;
 	if (reply.isValid()) {
 		auto dbusFlatTree = reply.value();
+		flatTree.nodes.reserve(dbusFlatTree.size());
 		for (auto &f_node : dbusFlatTree) {
 			// qDebug() << f_node.value.interface << f_node.value.path;
-			FlatTreeNode<TCDBus::DeviceNode> node{
-			    f_node.value, f_node.childIndices.toStdVector()};
-			flatTree.nodes.push_back(node);
+			auto &indices = f_node.childIndices;
+			flatTree.nodes.push_back({std::move(f_node.value),
+			    std::vector<int>(indices.begin(), indices.end())});
 		}
 	}
 
-	auto root = flatTree.toTree(flatTree);
+	auto root = FlatTree<TCDBus::DeviceNode>::toTree(std::move(flatTree));
 
 	auto model = new DeviceModel(root);
 	auto browser = new DeviceBrowser(*model);
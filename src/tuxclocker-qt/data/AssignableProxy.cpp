@@ -1,11 +1,12 @@
 #include "AssignableProxy.hpp"
 
+#include "AssignmentBatcher.hpp"
 #include <DBusTypes.hpp>
-#include <DynamicReadableConnection.hpp>
-#include <Globals.hpp>
-#include <Utils.hpp>
-#include <QDBusReply>
+#include <DynamicReadableConnectionData.hpp>
 #include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusReply>
 
 namespace TCD = TuxClocker::DBus;
 
@@ -14,52 +15,29 @@ using namespace TuxClocker::Device;
 Q_DECLARE_METATYPE(TCD::Result<int>)
 Q_DECLARE_METATYPE(TCD::Result<QString>)
 Q_DECLARE_METATYPE(TCD::Result<QDBusVariant>)
+Q_DECLARE_METATYPE(TCD::ReadableConnection)
 
 AssignableProxy::AssignableProxy(QString path, QDBusConnection conn, QObject *parent)
     : QObject(parent) {
 	qDBusRegisterMetaType<TCD::Result<int>>();
 	qDBusRegisterMetaType<TCD::Result<QString>>();
 	qDBusRegisterMetaType<TCD::Result<QDBusVariant>>();
+	qDBusRegisterMetaType<TCD::ReadableConnection>();
 	m_iface =
 	    new QDBusInterface("org.tuxclocker", path, "org.tuxclocker.Assignable", conn, this);
 
-	m_connection = nullptr;
-}
-
-std::optional<AssignmentError> AssignableProxy::doApply(const QVariant &v) {
-	// qDebug() << v;
-	QDBusReply<TCD::Result<int>> reply = m_iface->call("assign", v);
-	if (reply.isValid()) {
-		TCD::Result<AssignmentError> ar{
-		    reply.value().error, static_cast<AssignmentError>(reply.value().value)};
-		// qDebug("Success!");
-		return ar.toOptional();
-	}
-	// TODO: indicate dbus error
-	return AssignmentError::UnknownError;
+	// Only the results of this Assignable are delivered
+	conn.connect("org.tuxclocker", "/", "org.tuxclocker", "connectionApplied", {path},
+	    QString{}, this, SLOT(onConnectionApplied(QDBusMessage)));
 }
 
-std::optional<DynamicReadableProxy *> fromPath(QString path) {
-	DynamicReadableProxy *retval = nullptr;
-
-	auto cb = [&](auto model, auto index, int row) {
-		auto ifaceIndex = model->index(row, DeviceModel::InterfaceColumn, index);
-		auto dynProxyV = ifaceIndex.data(DeviceModel::DynamicReadableProxyRole);
-
-		if (dynProxyV.isValid()) {
-			auto dynProxy = qvariant_cast<DynamicReadableProxy *>(dynProxyV);
-			if (dynProxy->dbusPath() == path) {
-				// TODO: stop recursing here
-				retval = dynProxy;
-			}
-		}
-		return model->index(row, DeviceModel::NameColumn, index);
-	};
-	Utils::traverseModel(cb, Globals::g_deviceModel);
-
-	if (retval)
-		return retval;
-	return std::nullopt;
+// Calls a method of the main object. A QDBusInterface for it would be introspected for every
+// proxy at startup
+QDBusPendingCall callDaemon(QDBusConnection conn, const QString &method, const QVariant &arg) {
+	auto message =
+	    QDBusMessage::createMethodCall("org.tuxclocker", "/", "org.tuxclocker", method);
+	message << arg;
+	return conn.asyncCall(message);
 }
 
 void AssignableProxy::apply() {
@@ -67,60 +45,88 @@ void AssignableProxy::apply() {
 	if (m_value.isNull())
 		return;
 
+	auto isConnection = m_value.canConvert<DynamicReadableConnectionData>();
 	// Stop existing parametrization
-	if (m_connection) {
-		emit connectionStopped(m_value);
-		disconnect(m_connection, nullptr, nullptr, nullptr);
-		m_connection->stop();
-		delete m_connection;
-		m_connection = nullptr;
+	if (m_connectionActive) {
+		emit connectionStopped(m_connectionValue);
+		// Otherwise replaced by the daemon
+		if (!isConnection)
+			stopConnection();
+		m_connectionActive = false;
 	}
 
-	// Parametrization
-	if (m_value.canConvert<DynamicReadableConnectionData>()) {
-		auto data = m_value.value<DynamicReadableConnectionData>();
-		auto opt = fromPath(data.dynamicReadablePath);
-
-		if (opt.has_value()) {
-			auto proxy = opt.value();
-			m_connection = new DynamicReadableConnection<uint>{*proxy, data};
-
-			// We use this to save succeeded parametrization data
-			// to settings, since keeping m_value around would affect the view
-			m_connectionValue = m_value;
-			startConnection();
-			m_signalConnectionSuccess = true;
-			m_value = QVariant();
-			return;
-		}
+	// Parametrization, evaluated by the daemon
+	if (isConnection) {
+		// We use this to save succeeded parametrization data
+		// to settings, since keeping m_value around would affect the view
+		m_connectionValue = m_value;
+		m_value = QVariant();
+		startConnection(m_connectionValue.value<DynamicReadableConnectionData>());
+		return;
 	}
 
-	// Use QDBusVariant since otherwise tries to call with the wrong signature
-	QDBusVariant dv(m_value);
-	QVariant v;
-	v.setValue(dv);
-	emit applied(doApply(v));
-	// Indicate that there's no pending value to applied by making value invalid
-	m_value = QVariant();
+	// Applied together with the other assignables applied at the same time
+	AssignmentBatcher::instance(m_iface->connection()).add(this, m_value);
+}
+
+void AssignableProxy::finishApply(std::optional<AssignmentError> error, const QVariant &value) {
+	emit applied(error);
+	// Indicate that there's no pending value to applied by making value invalid,
+	// unless a new one was set while this one was being applied
+	if (m_value == value)
+		m_value = QVariant();
+}
+
+void AssignableProxy::stopConnection() {
+	callDaemon(m_iface->connection(), "removeConnection", dbusPath());
+	m_connectionActive = false;
 }
 
-void AssignableProxy::startConnection() {
-	QObject::connect(m_connection, &AssignableConnection::targetValueChanged,
-	    [this](auto targetValue, auto text) {
-		    auto err = doApply(targetValue);
-		    if (err.has_value())
-			    emit connectionValueChanged(err.value(), text);
-		    else {
-			    emit connectionValueChanged(targetValue, text);
-			    if (m_signalConnectionSuccess) {
-				    emit connectionSucceeded(m_connectionValue);
-				    m_signalConnectionSuccess = false;
-			    }
-		    }
-	    });
-	// Emit started signal in case a connection emits a new value right away
+void AssignableProxy::setActiveConnection(const DynamicReadableConnectionData &data) {
+	m_connectionValue = QVariant::fromValue(data);
+	m_connectionActive = true;
 	emit connectionStarted();
-	m_connection->start();
+}
+
+void AssignableProxy::startConnection(const DynamicReadableConnectionData &data) {
+	TCD::ReadableConnection connection{.targetPath = dbusPath(),
+	    .sourcePath = data.dynamicReadablePath,
+	    .points = data.points,
+	    // Default interval
+	    .interval = 0};
+	auto asyncCall = callDaemon(
+	    m_iface->connection(), "setConnection", QVariant::fromValue(connection));
+	auto watcher = new QDBusPendingCallWatcher{asyncCall, this};
+	connect(watcher, &QDBusPendingCallWatcher::finished, [=](QDBusPendingCallWatcher *call) {
+		QDBusPendingReply<bool> reply = *call;
+		if (reply.isValid() && reply.value()) {
+			m_connectionActive = true;
+			emit connectionStarted();
+			emit connectionSucceeded(m_connectionValue);
+		} else
+			// TODO: indicate dbus error
+			emit applied(AssignmentError::UnknownError);
+		delete call;
+	});
+}
+
+void AssignableProxy::onConnectionApplied(const QDBusMessage &message) {
+	auto args = message.arguments();
+	if (!m_connectionActive || args.size() != 3)
+		return;
+
+	TCD::Result<int> result;
+	args[2].value<QDBusArgument>() >> result;
+	if (result.error) {
+		emit connectionValueChanged(static_cast<AssignmentError>(result.value), QString{});
+		return;
+	}
+	auto value = args[1].value<QDBusVariant>().variant();
+	// TODO: don't hardcode precision in different places
+	auto text = (static_cast<QMetaType::Type>(value.type()) == QMetaType::Double)
+			? QString::number(value.toDouble(), 'f', 2)
+			: QString::number(value.toInt());
+	emit connectionValueChanged(value, text);
 }
 
 // DBus type to the more precise C++ type
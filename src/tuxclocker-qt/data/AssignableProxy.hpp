@@ -2,13 +2,12 @@
 
 // Acts as a buffer for unapplied assignables and applies them asynchronously
 
-#include <AssignableConnection.hpp>
 #include <Device.hpp>
-#include <DynamicReadableConnection.hpp>
-#include <memory>
+#include <DynamicReadableConnectionData.hpp>
 #include <QDebug>
 #include <QDBusConnection>
 #include <QDBusInterface>
+#include <QDBusMessage>
 #include <QObject>
 #include <variant>
 
@@ -20,11 +19,15 @@ public:
 	void apply();
 	// Stop connection and clear current connection
 	void stopConnection();
+	// Show a connection that was already running in the daemon as the active one
+	void setActiveConnection(const DynamicReadableConnectionData &data);
 	// TODO: rename to setTargetValue for congruency
 	void setValue(QVariant v) { m_value = v; }
 	QVariant targetValue() { return m_value; }
 	std::optional<TC::Device::AssignmentArgument> currentValue();
 	QString dbusPath();
+	// Called with the result of applying 'value', the target value in apply()
+	void finishApply(std::optional<TC::Device::AssignmentError> error, const QVariant &value);
 signals:
 	void applied(std::optional<TC::Device::AssignmentError>);
 	void connectionValueChanged(
@@ -32,18 +35,16 @@ signals:
 	void connectionSucceeded(QVariant);
 	void connectionStarted();
 	void connectionStopped(QVariant);
+private slots:
+	void onConnectionApplied(const QDBusMessage &message);
 private:
 	Q_OBJECT
 
 	QVariant m_value;
 	QVariant m_connectionValue;
 	QDBusInterface *m_iface;
-	DynamicReadableConnection<uint> *m_connection;
-	bool m_signalConnectionSuccess;
+	// Connections run in the daemon, see 'setConnection' in doc/DBus.md
+	bool m_connectionActive = false;
 
-	// This is a bit of a peril but not sure if we can store interfaces any better...
-	std::shared_ptr<AssignableConnection> m_assignableConnection;
-
-	std::optional<TC::Device::AssignmentError> doApply(const QVariant &v);
-	void startConnection();
+	void startConnection(const DynamicReadableConnectionData &data);
 };
@@ -0,0 +1,67 @@
+#include "AssignmentBatcher.hpp"
+
+#include "AssignableProxy.hpp"
+#include <QCoreApplication>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDebug>
+
+namespace TCD = TuxClocker::DBus;
+
+using namespace TuxClocker::Device;
+
+Q_DECLARE_METATYPE(TCD::Result<int>)
+Q_DECLARE_METATYPE(TCD::BatchAssignment)
+
+AssignmentBatcher::AssignmentBatcher(QDBusConnection conn, QObject *parent)
+    : QObject(parent), m_iface("org.tuxclocker", "/", "org.tuxclocker", conn) {
+	qDBusRegisterMetaType<TCD::Result<int>>();
+	qDBusRegisterMetaType<QVector<TCD::Result<int>>>();
+	qDBusRegisterMetaType<TCD::BatchAssignment>();
+	qDBusRegisterMetaType<QVector<TCD::BatchAssignment>>();
+
+	m_sendTimer.setSingleShot(true);
+	connect(&m_sendTimer, &QTimer::timeout, [=] { send(); });
+}
+
+AssignmentBatcher &AssignmentBatcher::instance(QDBusConnection conn) {
+	static auto batcher = new AssignmentBatcher(conn, QCoreApplication::instance());
+	return *batcher;
+}
+
+void AssignmentBatcher::add(AssignableProxy *proxy, const QVariant &value) {
+	m_proxies.append(proxy);
+	m_assignments.append({proxy->dbusPath(), QDBusVariant(value)});
+	if (!m_sendTimer.isActive())
+		m_sendTimer.start(0);
+}
+
+void AssignmentBatcher::send() {
+	auto proxies = m_proxies;
+	auto assignments = m_assignments;
+	m_proxies.clear();
+	m_assignments.clear();
+	auto asyncCall = m_iface.asyncCall("applyBatch", QVariant::fromValue(assignments));
+
+	auto watcher = new QDBusPendingCallWatcher{asyncCall};
+	connect(watcher, &QDBusPendingCallWatcher::finished, [=](QDBusPendingCallWatcher *call) {
+		QDBusPendingReply<QVector<TCD::Result<int>>> reply = *call;
+		if (!reply.isValid())
+			qWarning() << "Couldn't apply assignables:" << reply.error().message();
+
+		auto results = reply.isValid() ? reply.value() : QVector<TCD::Result<int>>{};
+		for (int i = 0; i < proxies.size(); i++) {
+			if (!proxies[i])
+				continue;
+			// TODO: indicate dbus error
+			std::optional<AssignmentError> error = AssignmentError::UnknownError;
+			if (i < results.size() && !results[i].error)
+				error = std::nullopt;
+			else if (i < results.size())
+				error = static_cast<AssignmentError>(results[i].value);
+			proxies[i]->finishApply(error, assignments[i].value.variant());
+		}
+		delete call;
+	});
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// Collects the assignables applied at the same time into one daemon call, so the changes of
+// a device can be committed at once
+
+#include <DBusTypes.hpp>
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+class AssignableProxy;
+
+class AssignmentBatcher : public QObject {
+public:
+	AssignmentBatcher(QDBusConnection conn, QObject *parent = nullptr);
+	// Shared instance for the connection
+	static AssignmentBatcher &instance(QDBusConnection conn);
+	// The result is passed to AssignableProxy::finishApply
+	void add(AssignableProxy *proxy, const QVariant &value);
+private:
+	Q_OBJECT
+
+	QDBusInterface m_iface;
+	// Same order as 'm_assignments'
+	QVector<QPointer<AssignableProxy>> m_proxies;
+	QVector<TuxClocker::DBus::BatchAssignment> m_assignments;
+	// Sends everything added in the same event loop iteration together
+	QTimer m_sendTimer;
+
+	void send();
+};
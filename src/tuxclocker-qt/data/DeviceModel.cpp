@@ -28,6 +28,7 @@ Q_DECLARE_METATYPE(TCDBus::Enumeration)
 Q_DECLARE_METATYPE(TCDBus::Range)
 Q_DECLARE_METATYPE(EnumerationVec)
 Q_DECLARE_METATYPE(TCDBus::Result<QString>)
+Q_DECLARE_METATYPE(TCDBus::ReadableConnection)
 
 DeviceModel::DeviceModel(TC::TreeNode<TCDBus::DeviceNode> root, QObject *parent)
     : QStandardItemModel(parent) {
@@ -35,6 +36,18 @@ DeviceModel::DeviceModel(TC::TreeNode<TCDBus::DeviceNode> root, QObject *parent)
 	qDBusRegisterMetaType<QVector<TCDBus::Enumeration>>();
 	qDBusRegisterMetaType<TCDBus::Range>();
 	qDBusRegisterMetaType<TCDBus::Result<QString>>();
+	qDBusRegisterMetaType<TCDBus::ReadableConnection>();
+	qDBusRegisterMetaType<QVector<TCDBus::ReadableConnection>>();
+
+	// Connections keep running in the daemon after the GUI is closed
+	QDBusInterface mainIface{
+	    "org.tuxclocker", "/", "org.tuxclocker", QDBusConnection::systemBus()};
+	QDBusReply<QVector<TCDBus::ReadableConnection>> connReply = mainIface.call("connections");
+	if (connReply.isValid()) {
+		for (auto &connection : connReply.value())
+			m_daemonConnections.insert(connection.targetPath, connection);
+	} else
+		qWarning() << "Couldn't get connections:" << connReply.error().message();
 
 	/* Data storage:
 		- Interface column should store assignable info for editors
@@ -43,64 +56,123 @@ DeviceModel::DeviceModel(TC::TreeNode<TCDBus::DeviceNode> root, QObject *parent)
 
 	setColumnCount(2);
 
-	std::function<void(TC::TreeNode<TCDBus::DeviceNode> node, QStandardItem *)> traverse;
-	traverse = [&traverse, this](auto node, auto item) {
-		auto conn = QDBusConnection::systemBus();
-		QDBusInterface nodeIface(
-		    "org.tuxclocker", node.value().path, "org.tuxclocker.Node", conn);
-		auto nodeName = nodeIface.property("name").toString();
-
-		QList<QStandardItem *> rowItems;
-		auto nameItem = new QStandardItem;
-		nameItem->setText(nodeName);
-		nameItem->setData(node.value().path, NodePathRole);
-		rowItems.append(nameItem);
-
-		p::match(node.value().interface)(
-		    pattern("org.tuxclocker.Assignable") =
-			[=, &rowItems] {
-				if_let(pattern(some(arg)) =
-					   setupAssignable(node, conn)) = [&](auto item) {
-					nameItem->setData(Assignable, InterfaceTypeRole);
-					auto icon = assignableIcon();
-					nameItem->setData(icon, Qt::DecorationRole);
-					rowItems.append(item);
-				};
-			},
-		    pattern("org.tuxclocker.DynamicReadable") =
-			[=, &rowItems] {
-				if_let(pattern(some(arg)) =
-					   setupDynReadable(node, conn)) = [&](auto item) {
-					auto icon = dynamicReadableIcon();
-					nameItem->setData(icon, Qt::DecorationRole);
-
-					nameItem->setData(
-					    DeviceModel::DynamicReadable, InterfaceTypeRole);
-					rowItems.append(item);
-					// qDebug() << item->data(DynamicReadableProxyRole);
-				};
-			},
-		    pattern("org.tuxclocker.StaticReadable") =
-			[=, &rowItems] {
-				if_let(pattern(some(arg)) =
-					   setupStaticReadable(node, conn)) = [&](auto item) {
-					auto icon = staticReadableIcon();
-					nameItem->setData(icon, Qt::DecorationRole);
-					nameItem->setData(
-					    DeviceModel::StaticReadable, InterfaceTypeRole);
-					rowItems.append(item);
-				};
-			},
-		    pattern(_) = [] {});
-		item->appendRow(rowItems);
-
-		for (auto c_node : node.children())
+	std::function<void(const TC::TreeNode<TCDBus::DeviceNode> &node, QStandardItem *)> traverse;
+	traverse = [&traverse, this](auto &node, auto item) {
+		auto nameItem = appendNode(node, item);
+		for (auto &c_node : node.children())
 			traverse(c_node, nameItem);
 	};
 	auto rootItem = invisibleRootItem();
 
 	for (auto &node : root.children())
 		traverse(node, rootItem);
+
+	QDBusConnection::systemBus().connect("org.tuxclocker", "/", "org.tuxclocker",
+	    "deviceTreeChanged", this, SLOT(onDeviceTreeChanged(QDBusMessage)));
+}
+
+void DeviceModel::onDeviceTreeChanged(const QDBusMessage &message) {
+	auto args = message.arguments();
+	if (args.size() != 2)
+		return;
+	for (auto &path : args[0].toStringList())
+		removeNode(path);
+
+	auto added = qdbus_cast<QVector<TCDBus::DeviceNode>>(args[1].value<QDBusArgument>());
+	// In preorder, so parents are added before their children
+	for (auto &node : added) {
+		auto parentPath = node.path.section('/', 0, -2);
+		auto parent =
+		    parentPath.isEmpty() ? invisibleRootItem() : m_nameItems.value(parentPath);
+		if (parent)
+			appendNode(TC::TreeNode<TCDBus::DeviceNode>{node}, parent);
+	}
+}
+
+void DeviceModel::removeNode(const QString &path) {
+	auto nameItem = m_nameItems.value(path);
+	if (!nameItem)
+		return;
+
+	// Proxies would keep calling the removed path. Disconnected right away, since their
+	// signals update the removed items
+	auto deleteProxy = [](QObject *proxy) {
+		proxy->disconnect();
+		proxy->deleteLater();
+	};
+	auto prefix = path + "/";
+	for (auto it = m_nameItems.begin(); it != m_nameItems.end();) {
+		if (it.key() != path && !it.key().startsWith(prefix)) {
+			it++;
+			continue;
+		}
+		auto item = it.value();
+		auto parent = item->parent() ? item->parent() : invisibleRootItem();
+		if (auto ifaceItem = parent->child(item->row(), InterfaceColumn)) {
+			auto assignableV = ifaceItem->data(AssignableProxyRole);
+			if (assignableV.isValid())
+				deleteProxy(qvariant_cast<AssignableProxy *>(assignableV));
+			auto readableV = ifaceItem->data(DynamicReadableProxyRole);
+			if (readableV.isValid())
+				deleteProxy(qvariant_cast<DynamicReadableProxy *>(readableV));
+		}
+		m_activeConnections.removeOne(DynamicReadableConnectionData{
+		    .dynamicReadablePath = it.key(),
+		});
+		it = m_nameItems.erase(it);
+	}
+	auto parent = nameItem->parent() ? nameItem->parent() : invisibleRootItem();
+	parent->removeRow(nameItem->row());
+}
+
+QStandardItem *DeviceModel::appendNode(
+    const TC::TreeNode<TCDBus::DeviceNode> &node, QStandardItem *item) {
+	auto conn = QDBusConnection::systemBus();
+	QDBusInterface nodeIface("org.tuxclocker", node.value().path, "org.tuxclocker.Node", conn);
+	auto nodeName = nodeIface.property("name").toString();
+
+	QList<QStandardItem *> rowItems;
+	auto nameItem = new QStandardItem;
+	nameItem->setText(nodeName);
+	nameItem->setData(node.value().path, NodePathRole);
+	rowItems.append(nameItem);
+
+	p::match(node.value().interface)(
+	    pattern("org.tuxclocker.Assignable") =
+		[=, &rowItems] {
+			if_let(pattern(some(arg)) = setupAssignable(node, conn)) = [&](auto item) {
+				nameItem->setData(Assignable, InterfaceTypeRole);
+				auto icon = assignableIcon();
+				nameItem->setData(icon, Qt::DecorationRole);
+				rowItems.append(item);
+			};
+		},
+	    pattern("org.tuxclocker.DynamicReadable") =
+		[=, &rowItems] {
+			if_let(pattern(some(arg)) = setupDynReadable(node, conn)) = [&](auto item) {
+				auto icon = dynamicReadableIcon();
+				nameItem->setData(icon, Qt::DecorationRole);
+
+				nameItem->setData(DeviceModel::DynamicReadable, InterfaceTypeRole);
+				rowItems.append(item);
+				// qDebug() << item->data(DynamicReadableProxyRole);
+			};
+		},
+	    pattern("org.tuxclocker.StaticReadable") =
+		[=, &rowItems] {
+			if_let(pattern(some(arg)) =
+				   setupStaticReadable(node, conn)) = [&](auto item) {
+				auto icon = staticReadableIcon();
+				nameItem->setData(icon, Qt::DecorationRole);
+				nameItem->setData(DeviceModel::StaticReadable, InterfaceTypeRole);
+				rowItems.append(item);
+			};
+		},
+	    pattern(_) = [] {});
+	item->appendRow(rowItems);
+
+	m_nameItems.insert(node.value().path, nameItem);
+	return nameItem;
 }
 
 EnumerationVec toEnumVec(QVector<TCDBus::Enumeration> enums) {
@@ -127,7 +199,8 @@ QString fromAssignmentArgument(AssignmentArgument a_arg) {
 }
 
 QStandardItem *DeviceModel::createAssignable(
-    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn, AssignableItemData itemData) {
+    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn,
+    AssignableItemData itemData) {
 	auto ifaceItem = new AssignableItem(itemData.unit(), this);
 	auto proxy = new AssignableProxy(node.value().path, conn, this);
 
@@ -167,6 +240,19 @@ QStandardItem *DeviceModel::createAssignable(
 		Utils::writeAssignableSetting(newSettings, assSetting);
 	});
 
+	if (m_daemonConnections.contains(proxy->dbusPath())) {
+		auto connection = m_daemonConnections.value(proxy->dbusPath());
+		DynamicReadableConnectionData data{
+		    .points = connection.points,
+		    .dynamicReadablePath = connection.sourcePath,
+		};
+		auto info = itemData.assignableInfo();
+		if (std::holds_alternative<RangeInfo>(info))
+			data.rangeInfo = std::get<RangeInfo>(info);
+		proxy->setActiveConnection(data);
+		m_activeConnections.append(data);
+	}
+
 	QVariant pv;
 	pv.setValue(proxy);
 	ifaceItem->setData(pv, AssignableProxyRole);
@@ -294,7 +380,7 @@ std::optional<QString> fromDBusResult(TCDBus::Result<QString> res) {
 }
 
 std::optional<QStandardItem *> DeviceModel::setupAssignable(
-    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn) {
+    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn) {
 	QDBusInterface ifaceNode(
 	    "org.tuxclocker", node.value().path, "org.tuxclocker.Assignable", conn);
 
@@ -357,7 +443,7 @@ void updateReadItemText(QStandardItem *item, T value, std::optional<QString> uni
 }
 
 std::optional<QStandardItem *> DeviceModel::setupDynReadable(
-    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn) {
+    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn) {
 	auto item = new QStandardItem;
 	auto proxy = new DynamicReadableProxy(node.value().path, conn, this);
 	QVariant v;
@@ -385,7 +471,7 @@ std::optional<QStandardItem *> DeviceModel::setupDynReadable(
 }
 
 std::optional<QStandardItem *> DeviceModel::setupStaticReadable(
-    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn) {
+    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn) {
 	QDBusInterface staticIface(
 	    "org.tuxclocker", node.value().path, "org.tuxclocker.StaticReadable", conn);
 	auto value = staticIface.property("value").value<QDBusVariant>().variant().toString();
@@ -10,6 +10,7 @@
 #include <patterns.hpp>
 #include <QDBusConnection>
 #include <QDBusInterface>
+#include <QDBusMessage>
 #include <QFlags>
 #include <QHash>
 #include <QIcon>
@@ -63,21 +64,35 @@ public:
 	QVector<DynamicReadableConnectionData> activeConnections() { return m_activeConnections; }
 signals:
 	void changesApplied();
+private slots:
+	// Removes and adds the nodes of hotplugged devices, see 'deviceTreeChanged' in doc/DBus.md
+	void onDeviceTreeChanged(const QDBusMessage &message);
 private:
 	Q_OBJECT
 
 	QVector<DynamicReadableConnectionData> m_activeConnections;
+	// Connections running in the daemon at startup, by the path of the Assignable
+	QHash<QString, TCDBus::ReadableConnection> m_daemonConnections;
+	// Items of the name column by node path
+	QHash<QString, QStandardItem *> m_nameItems;
+
+	// Appends the row of the node to 'item' and returns its name item
+	QStandardItem *appendNode(
+	    const TC::TreeNode<TCDBus::DeviceNode> &node, QStandardItem *item);
+	// Removes the row of the node and its children, and their proxies
+	void removeNode(const QString &path);
 	QHash<QStandardItem *, AssignableProxy *> m_assignableProxyHash;
 
 	// Separate handling interfaces since otherwise we run out of columns
 	QStandardItem *createAssignable(
-	    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn, AssignableItemData data);
+	    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn,
+	    AssignableItemData data);
 	std::optional<QStandardItem *> setupAssignable(
-	    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn);
+	    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn);
 	std::optional<QStandardItem *> setupDynReadable(
-	    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn);
+	    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn);
 	std::optional<QStandardItem *> setupStaticReadable(
-	    TC::TreeNode<TCDBus::DeviceNode> node, QDBusConnection conn);
+	    const TC::TreeNode<TCDBus::DeviceNode> &node, QDBusConnection conn);
 	QString displayText(AssignableProxy *proxy, AssignableItemData data);
 	constexpr int fadeOutTime() { return 5000; } // milliseconds
 	constexpr int transparency() { return 120; } // 0-255
@@ -4,24 +4,25 @@
 #include <QDBusConnection>
 #include <QDBusInterface>
 #include <QObject>
-#include <QTimer>
 
+class DynamicReadableSubscriber;
+
+// Values are pushed by the daemon through DynamicReadableSubscriber, and only when they change
 class DynamicReadableProxy : public QObject {
 public:
 	DynamicReadableProxy(QString path, QDBusConnection conn, QObject *parent = nullptr);
+	~DynamicReadableProxy();
 	std::optional<QString> unit();
 	QString dbusPath() { return m_iface.path(); }
-	void suspend() { m_timer.stop(); }
-	void resume() {
-		if (!m_timer.isActive())
-			m_timer.start(m_updateInterval);
-	}
+	void suspend();
+	void resume();
+	// Called by DynamicReadableSubscriber
+	void receiveValue(TuxClocker::Device::ReadResult val) { emit valueChanged(val); }
 signals:
 	void valueChanged(TuxClocker::Device::ReadResult val);
 private:
 	Q_OBJECT
 
-	static constexpr int m_updateInterval = 1000;
 	QDBusInterface m_iface;
-	QTimer m_timer; // Emits latest value
+	DynamicReadableSubscriber &m_subscriber;
 };
@@ -0,0 +1,91 @@
+#include "DynamicReadableSubscriber.hpp"
+
+#include "DynamicReadableProxy.hpp"
+#include <DBusTypes.hpp>
+#include <QCoreApplication>
+#include <QDBusArgument>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDebug>
+
+namespace TCD = TuxClocker::DBus;
+
+Q_DECLARE_METATYPE(TCD::BatchValue)
+Q_DECLARE_METATYPE(TCD::ValueBatch)
+
+DynamicReadableSubscriber::DynamicReadableSubscriber(
+    QDBusConnection conn, int interval, QObject *parent)
+    : QObject(parent), m_iface("org.tuxclocker", "/", "org.tuxclocker", conn),
+      m_interval(interval) {
+	qDBusRegisterMetaType<TCD::BatchValue>();
+	qDBusRegisterMetaType<QVector<TCD::BatchValue>>();
+	qDBusRegisterMetaType<TCD::ValueBatch>();
+
+	m_resubscribeTimer.setSingleShot(true);
+	connect(&m_resubscribeTimer, &QTimer::timeout, [=] { resubscribe(); });
+
+	// Signals are only sent to the subscriber
+	conn.connect("org.tuxclocker", "/", "org.tuxclocker", "valuesChanged", this,
+	    SLOT(onValuesChanged(QDBusMessage)));
+}
+
+DynamicReadableSubscriber &DynamicReadableSubscriber::instance(QDBusConnection conn) {
+	static auto subscriber =
+	    new DynamicReadableSubscriber(conn, m_defaultInterval, QCoreApplication::instance());
+	return *subscriber;
+}
+
+void DynamicReadableSubscriber::add(DynamicReadableProxy *proxy) {
+	if (m_proxies.contains(proxy->dbusPath(), proxy))
+		return;
+	m_proxies.insert(proxy->dbusPath(), proxy);
+	m_resubscribeTimer.start(0);
+}
+
+void DynamicReadableSubscriber::remove(DynamicReadableProxy *proxy) {
+	if (m_proxies.remove(proxy->dbusPath(), proxy) > 0)
+		m_resubscribeTimer.start(0);
+}
+
+void DynamicReadableSubscriber::onValuesChanged(const QDBusMessage &message) {
+	auto args = message.arguments();
+	if (args.size() != 2 || args[0].toUInt() != m_subscriptionId || m_subscriptionId == 0)
+		return;
+
+	TCD::ValueBatch batch;
+	args[1].value<QDBusArgument>() >> batch;
+	for (int i = 0; i < batch.paths.size() && i < batch.values.size(); i++) {
+		auto result = batch.values[i].toReadResult();
+		for (auto proxy : m_proxies.values(batch.paths[i]))
+			proxy->receiveValue(result);
+	}
+}
+
+void DynamicReadableSubscriber::resubscribe() {
+	m_generation++;
+	if (m_subscriptionId != 0) {
+		m_iface.asyncCall("unsubscribe", m_subscriptionId);
+		m_subscriptionId = 0;
+	}
+	auto paths = m_proxies.uniqueKeys();
+	if (paths.isEmpty())
+		return;
+
+	// Initial values of all paths come in the first signal
+	auto asyncCall =
+	    m_iface.asyncCall("subscribe", QStringList{paths}, static_cast<uint>(m_interval));
+	auto watcher = new QDBusPendingCallWatcher{asyncCall};
+	auto generation = m_generation;
+	connect(watcher, &QDBusPendingCallWatcher::finished, [=](QDBusPendingCallWatcher *call) {
+		QDBusPendingReply<uint> reply = *call;
+		if (!reply.isValid())
+			qWarning() << "Couldn't subscribe to readables:" << reply.error().message();
+		else if (generation != m_generation)
+			// Superseded by a newer resubscription before this one finished
+			m_iface.asyncCall("unsubscribe", reply.value());
+		else
+			m_subscriptionId = reply.value();
+		delete call;
+	});
+}
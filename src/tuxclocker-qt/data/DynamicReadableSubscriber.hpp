@@ -0,0 +1,38 @@
+#pragma once
+
+// Keeps a single daemon subscription for the values of all active DynamicReadableProxies
+
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusMessage>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+class DynamicReadableProxy;
+
+class DynamicReadableSubscriber : public QObject {
+public:
+	DynamicReadableSubscriber(QDBusConnection conn, int interval, QObject *parent = nullptr);
+	// Shared instance for the connection
+	static DynamicReadableSubscriber &instance(QDBusConnection conn);
+	void add(DynamicReadableProxy *proxy);
+	void remove(DynamicReadableProxy *proxy);
+private slots:
+	void onValuesChanged(const QDBusMessage &message);
+private:
+	Q_OBJECT
+
+	static constexpr int m_defaultInterval = 1000;
+	QDBusInterface m_iface;
+	int m_interval;
+	QMultiHash<QString, DynamicReadableProxy *> m_proxies;
+	// Zero if not subscribed
+	uint m_subscriptionId = 0;
+	// Replies to earlier subscribe calls are stale
+	uint m_generation = 0;
+	// Coalesces proxies being added and removed into one resubscription
+	QTimer m_resubscribeTimer;
+
+	void resubscribe();
+};
@@ -1,13 +1,24 @@
 #pragma once
 
 #include "Adaptors.hpp"
+#include "Connections.hpp"
+#include "DeviceRegistry.hpp"
+#include "DeviceTreeObject.hpp"
+#include "History.hpp"
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+#include "Subscriptions.hpp"
+#include "Telemetry.hpp"
 #include <DBusTypes.hpp>
 #include <Device.hpp>
 #include <Tree.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <patterns.hpp>
 #include <QDBusAbstractAdaptor>
 #include <QDBusArgument>
+#include <QDBusMessage>
 #include <QDBusVariant>
 #include <QDBusMetaType>
 #include <QDebug>
@@ -18,243 +29,204 @@ using namespace mpark::patterns;
 
 namespace TCDBus = TuxClocker::DBus;
 
-Q_DECLARE_METATYPE(TCDBus::Result<QDBusVariant>)
-Q_DECLARE_METATYPE(TCDBus::Result<QString>)
+Q_DECLARE_METATYPE(TCDBus::DeviceNode)
+Q_DECLARE_METATYPE(TCDBus::FlatTreeNode<TCDBus::DeviceNode>)
+Q_DECLARE_METATYPE(TCDBus::BatchAssignment)
+Q_DECLARE_METATYPE(TCDBus::HistoryBucket)
+Q_DECLARE_METATYPE(TCDBus::CircuitBreakerState)
+Q_DECLARE_METATYPE(TCDBus::TimedValue)
 
-/* On success, returns the value, on error 'error' field is set and the error
-   code is stored in 'value' */
-class DynamicReadableAdaptor : public QDBusAbstractAdaptor {
+// Holds the main tree and returns it as a list (because parsing XML sucks)
+class MainAdaptor : public QDBusAbstractAdaptor {
 public:
-	explicit DynamicReadableAdaptor(QObject *obj, DynamicReadable dr)
-	    : QDBusAbstractAdaptor(obj) {
-		// Ideally this should be moved somewhere else but QMetaType does not handle
-		// namespaces well
-		qDBusRegisterMetaType<TCDBus::Result<QDBusVariant>>();
-		qDBusRegisterMetaType<TCDBus::Result<QString>>();
-		m_dynamicReadable = dr;
-	}
-	// Might not have a unit
-	TCDBus::Result<QString> unit_() {
-		return (m_dynamicReadable.unit().has_value())
-			   ? TCDBus::Result<QString>{false,
-				 QString::fromStdString(m_dynamicReadable.unit().value())}
-			   : TCDBus::Result<QString>{true, QString("")};
+	explicit MainAdaptor(QObject *obj, QDBusConnection connection, DeviceRegistry &registry,
+	    ReadableTable &readables, Sampler &sampler, DeviceTreeObject &deviceTree,
+	    Subscriptions &subscriptions, Telemetry &telemetry, Connections &connections,
+	    History &history)
+	    : QDBusAbstractAdaptor(obj), m_connection(connection), m_readables(readables),
+	      m_sampler(sampler), m_deviceTree(deviceTree), m_subscriptions(subscriptions),
+	      m_telemetry(telemetry), m_connections(connections), m_history(history) {
+		qDBusRegisterMetaType<TCDBus::DeviceNode>();
+		qDBusRegisterMetaType<QVector<TCDBus::DeviceNode>>();
+		qDBusRegisterMetaType<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>();
+		qDBusRegisterMetaType<QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>>();
+		qDBusRegisterMetaType<TCDBus::BatchValue>();
+		qDBusRegisterMetaType<QVector<TCDBus::BatchValue>>();
+		qDBusRegisterMetaType<TCDBus::ValueBatch>();
+		qDBusRegisterMetaType<TCDBus::BatchAssignment>();
+		qDBusRegisterMetaType<QVector<TCDBus::BatchAssignment>>();
+		qDBusRegisterMetaType<QVector<TCDBus::Result<int>>>();
+		qDBusRegisterMetaType<TCDBus::ReadableConnection>();
+		qDBusRegisterMetaType<QVector<TCDBus::ReadableConnection>>();
+		qDBusRegisterMetaType<TCDBus::HistoryBucket>();
+		qDBusRegisterMetaType<QVector<TCDBus::HistoryBucket>>();
+		qDBusRegisterMetaType<TCDBus::CircuitBreakerState>();
+		qDBusRegisterMetaType<QVector<TCDBus::CircuitBreakerState>>();
+		qDBusRegisterMetaType<TCDBus::TimedValue>();
+		qDBusRegisterMetaType<QVector<TCDBus::TimedValue>>();
+
+		setFlatTree(registry.dbusTree());
+		registry.addListener([this, &registry](const DeviceRegistry::Change &change) {
+			setFlatTree(registry.dbusTree());
+			emit deviceTreeChanged(change.removed, change.added);
+		});
 	}
 public Q_SLOTS:
-	TCDBus::Result<QDBusVariant> value() {
-		QVariant v;
-		TCDBus::Result<QDBusVariant> res{.error = false};
-		/* We have to unwrap the value here, another option would be to convert the
-		 * std::variant to char*, but that comes with its own issues */
-		match(m_dynamicReadable.read())(
-		    pattern(as<ReadableValue>(arg)) =
-			[&](auto val) {
-				match(val)(
-				    pattern(as<uint>(arg)) = [&](auto u) { v.setValue(u); },
-				    pattern(as<double>(arg)) = [&](auto d) { v.setValue(d); });
-			},
-		    pattern(as<ReadError>(arg)) =
-			[&](auto err) {
-				v.setValue(static_cast<int>(err));
-				res.error = true;
-			});
-		res.value = QDBusVariant(v);
-		return res;
-	}
-private:
-	Q_OBJECT
-	Q_CLASSINFO("D-Bus Interface", "org.tuxclocker.DynamicReadable")
-	Q_PROPERTY(TCDBus::Result<QString> unit READ unit_)
-
-	DynamicReadable m_dynamicReadable;
-};
-
-Q_DECLARE_METATYPE(TCDBus::Range)
-Q_DECLARE_METATYPE(TCDBus::Enumeration)
-Q_DECLARE_METATYPE(TCDBus::Result<int>)
-Q_DECLARE_METATYPE(TCDBus::Result<double>)
-Q_DECLARE_METATYPE(TCDBus::Result<uint>)
-
-class AssignableAdaptor : public QDBusAbstractAdaptor {
-public:
-	explicit AssignableAdaptor(QObject *obj, Assignable a)
-	    : QDBusAbstractAdaptor(obj), m_assignable(a) {
-		qDBusRegisterMetaType<TCDBus::Range>();
-		qDBusRegisterMetaType<TCDBus::Enumeration>();
-		qDBusRegisterMetaType<QVector<TCDBus::Enumeration>>();
-		qDBusRegisterMetaType<TCDBus::Result<int>>();
-		qDBusRegisterMetaType<TCDBus::Result<double>>();
-		qDBusRegisterMetaType<TCDBus::Result<uint>>();
-		qDBusRegisterMetaType<TCDBus::Result<QString>>();
-		qDBusRegisterMetaType<TCDBus::Result<QDBusVariant>>();
-
-		QVariant a_info;
-		// Unwrap AssignableInfo :(
-		match(a.assignableInfo())(
-		    pattern(as<RangeInfo>(arg)) =
-			[&](auto r_info) {
-				match(r_info)(
-				    pattern(as<Range<double>>(arg)) =
-					[&](auto dr) {
-						TCDBus::Range r{
-						    .min = QDBusVariant(QVariant(dr.min)),
-						    .max = QDBusVariant(QVariant(dr.max))};
-						a_info.setValue(r);
-					},
-				    pattern(as<Range<int>>(arg)) =
-					[&](auto ir) {
-						TCDBus::Range r{
-						    .min = QDBusVariant(QVariant(ir.min)),
-						    .max = QDBusVariant(QVariant(ir.max))};
-						a_info.setValue(r);
-					});
-			},
-		    pattern(as<EnumerationVec>(arg)) =
-			[&](auto enums) {
-				QVector<TCDBus::Enumeration> entries;
-				for (const auto &e : enums)
-					entries.append({e.key, QString::fromStdString(e.name)});
-				a_info.setValue(entries);
-			});
-
-		m_dbusAssignableInfo = QDBusVariant(a_info);
+	QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>> flatDeviceTree() { return m_flatTree; }
+	// Reads the DynamicReadables at 'paths' in one call
+	TCDBus::ValueBatch readMany(QStringList paths) {
+		TCDBus::ValueBatch batch{.timestamp = monotonicTimestamp(), .paths = paths};
+		for (auto &path : paths) {
+			auto index = m_readables.indexOf(path);
+			if (!index.has_value()) {
+				// Nonexistent path
+				batch.values.append(TCDBus::BatchValue{
+				    true, 0, static_cast<double>(ReadError::UnknownError)});
+				continue;
+			}
+			batch.values.append(toBatchValue(m_sampler.latest(*index)));
+		}
+		return batch;
 	}
-	QDBusVariant assignableInfo_() { return m_dbusAssignableInfo; }
-	TCDBus::Result<QString> unit_() {
-		if (m_assignable.unit().has_value()) {
-			return TCDBus::Result<QString>{.error = false,
-			    .value = QString::fromStdString(m_assignable.unit().value())};
+	// Reads all DynamicReadables at or below 'path'
+	TCDBus::ValueBatch readAll(QString path) {
+		TCDBus::ValueBatch batch{.timestamp = monotonicTimestamp()};
+		for (auto index : m_readables.subtreeIndices(path)) {
+			batch.paths.append(m_readables.path(index));
+			batch.values.append(toBatchValue(m_sampler.latest(index)));
 		}
-		return TCDBus::Result<QString>{.error = true, .value = QString("")};
+		return batch;
 	}
-public Q_SLOTS:
-	TCDBus::Result<QDBusVariant> currentValue() {
-		// Indicate error by default
-		TCDBus::Result<QDBusVariant> retval{
-		    .error = true, .value = QDBusVariant(QVariant(0))};
-		match(m_assignable.currentValue())(
-		    pattern(some(arg)) =
-			[&](auto aa) {
-				retval.error = false;
-				match(aa)(
-				    pattern(as<double>(arg)) =
-					[&](auto d) { retval.value = QDBusVariant(QVariant(d)); },
-				    pattern(as<int>(arg)) =
-					[&](auto i) { retval.value = QDBusVariant(QVariant(i)); },
-				    pattern(as<uint>(arg)) =
-					[&](auto u) { retval.value = QDBusVariant(QVariant(u)); });
-			},
-		    pattern(none) = [] {});
+	// Latest samples of the DynamicReadables at 'paths', with their own timestamps
+	QVector<TCDBus::TimedValue> readSamples(QStringList paths) {
+		QVector<TCDBus::TimedValue> retval;
+		for (auto &path : paths) {
+			auto index = m_readables.indexOf(path);
+			if (!index.has_value()) {
+				// Nonexistent path
+				retval.append(TCDBus::TimedValue{
+				    0, 0, true, 0, static_cast<double>(ReadError::UnknownError)});
+				continue;
+			}
+			retval.append(toTimedValue(m_sampler.latest(*index)));
+		}
 		return retval;
 	}
-	TCDBus::Result<int> assign(QDBusVariant arg_) {
-		auto v = arg_.variant();
-
-		std::optional<AssignmentError> retval;
-
-		match(m_assignable.assignableInfo())(
-		    pattern(as<RangeInfo>(arg)) =
-			[&](auto ri) {
-				match(ri)(
-				    pattern(as<Range<double>>(_)) =
-					[&] { retval = m_assignable.assign(v.value<double>()); },
-				    pattern(as<Range<int>>(_)) =
-					[&] { retval = m_assignable.assign(v.value<int>()); });
-			},
-		    pattern(as<EnumerationVec>(_)) =
-			[&] { retval = m_assignable.assign(v.value<uint>()); });
-
-		TCDBus::Result<int> res{.error = false, 0};
-		// Check if optional contains error
-		if (retval.has_value()) {
-			res.error = true;
-			res.value = static_cast<int>(retval.value());
+	// Sets how often the DynamicReadables at 'paths' are sampled. Zero resets to default
+	bool setSamplingInterval(QStringList paths, uint milliseconds) {
+		auto interval = m_sampler.clientInterval(milliseconds);
+		bool found = true;
+		for (auto &path : paths) {
+			auto index = m_readables.indexOf(path);
+			if (index.has_value())
+				m_sampler.setInterval(*index, interval);
+			else
+				found = false;
 		}
-
-		return res;
+		return found;
 	}
-private:
-	Q_OBJECT
-	Q_CLASSINFO("D-Bus Interface", "org.tuxclocker.Assignable")
-	Q_PROPERTY(QDBusVariant assignableInfo READ assignableInfo_)
-	Q_PROPERTY(TCDBus::Result<QString> unit READ unit_)
-
-	Assignable m_assignable;
-	QDBusVariant m_dbusAssignableInfo;
-};
-
-Q_DECLARE_METATYPE(TCDBus::DeviceNode)
-Q_DECLARE_METATYPE(TCDBus::FlatTreeNode<TCDBus::DeviceNode>)
-
-// Holds the name and hash of nodes, even if they don't implement an interface
-class NodeAdaptor : public QDBusAbstractAdaptor {
-public:
-	NodeAdaptor(QObject *obj, DeviceNode devNode)
-	    : QDBusAbstractAdaptor(obj), m_devNode(devNode) {}
-	QString name_() { return QString::fromStdString(m_devNode.name); }
-	QString hash_() { return QString::fromStdString(m_devNode.hash); }
-private:
-	Q_OBJECT
-	Q_CLASSINFO("D-Bus Interface", "org.tuxclocker.Node")
-	Q_PROPERTY(QString hash READ hash_)
-	Q_PROPERTY(QString name READ name_)
-
-	DeviceNode m_devNode;
-};
-
-// Holds the main tree and returns it as a list (because parsing XML sucks)
-class MainAdaptor : public QDBusAbstractAdaptor {
-public:
-	explicit MainAdaptor(QObject *obj, TreeNode<TCDBus::DeviceNode> node)
-	    : QDBusAbstractAdaptor(obj) {
-		qDBusRegisterMetaType<TCDBus::DeviceNode>();
-		qDBusRegisterMetaType<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>();
-		qDBusRegisterMetaType<QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>>>();
-
-		for (const auto &f_node : node.toFlatTree().nodes) {
-			// Copy child indices
-			QVector<int> childIndices;
-			for (const auto &i : f_node.childIndices)
-				childIndices.append(i);
-
-			TCDBus::FlatTreeNode<TCDBus::DeviceNode> fn{f_node.value, childIndices};
-			m_flatTree.append(fn);
+	// Assigns all values before replying, committing changes once per device where possible.
+	// Results are in the same order as 'assignments'
+	QVector<TCDBus::Result<int>> applyBatch(
+	    QVector<TCDBus::BatchAssignment> assignments, const QDBusMessage &message) {
+		message.setDelayedReply(true);
+		m_deviceTree.applyBatch(assignments,
+		    [connection = m_connection, message](auto &results) {
+			    connection.send(message.createReply(QVariant::fromValue(results)));
+		    });
+		return {};
+	}
+	// Values of 'paths' are pushed to the caller with 'valuesChanged' at most every
+	// 'milliseconds'. Zero means the default interval
+	uint subscribe(QStringList paths, uint milliseconds, const QDBusMessage &message) {
+		return m_subscriptions.subscribe(
+		    message.service(), paths, m_sampler.clientInterval(milliseconds));
+	}
+	bool unsubscribe(uint id, const QDBusMessage &message) {
+		return m_subscriptions.unsubscribe(message.service(), id);
+	}
+	// Read-only descriptor of the shared memory ring the samples are written to
+	QDBusUnixFileDescriptor telemetryRing(const QDBusMessage &message) {
+		return m_telemetry.open(message);
+	}
+	// Keeps assigning the target the value of the source mapped through the points, until
+	// removed. Replaces the target's previous connection
+	bool setConnection(TCDBus::ReadableConnection connection) {
+		return m_connections.set(connection);
+	}
+	bool removeConnection(QString targetPath) { return m_connections.remove(targetPath); }
+	QVector<TCDBus::ReadableConnection> connections() { return m_connections.connections(); }
+	// Values of the DynamicReadable at 'path' in 'resolution' long buckets from 'from' to 'to',
+	// in nanoseconds on the daemon's monotonic clock. 'to' of zero means now
+	QVector<TCDBus::HistoryBucket> history(QString path, qulonglong from, qulonglong to,
+	    qulonglong resolution, const QDBusMessage &message) {
+		auto buckets = m_history.query(path, from, to, resolution);
+		if (!buckets.has_value()) {
+			message.setDelayedReply(true);
+			m_connection.send(message.createErrorReply(QDBusError::InvalidArgs,
+			    "Not a DynamicReadable, or invalid time range or resolution"));
+			return {};
 		}
+		return *buckets;
 	}
-public Q_SLOTS:
-	QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>> flatDeviceTree() { return m_flatTree; }
+	// Direct reads answered by a recent sample and ones that read the hardware, for tuning
+	// --coalescing-window
+	qulonglong coalescingStatistics(qulonglong &misses) {
+		auto statistics = m_sampler.coalescingStatistics();
+		misses = statistics.misses;
+		return statistics.hits;
+	}
+	// Nodes that are skipped because their reads keep failing or timed out, see --read-deadline
+	QVector<TCDBus::CircuitBreakerState> circuitBreakers() {
+		QVector<TCDBus::CircuitBreakerState> retval;
+		using namespace std::chrono;
+		auto now = CircuitBreaker::Clock::now();
+		auto append = [&](const QString &path, CircuitBreaker::Status status) {
+			auto retryIn = duration_cast<nanoseconds>(status.retryAt - now).count();
+			retval.append({path, static_cast<uchar>(status.state), status.failures,
+			    static_cast<qulonglong>(std::max<decltype(retryIn)>(retryIn, 0))});
+		};
+		for (int i = 0; i < m_readables.size(); i++) {
+			if (m_readables.removed(i))
+				continue;
+			auto status = m_sampler.breakerStatus(i);
+			if (status.state != CircuitBreaker::State::Closed)
+				append(m_readables.path(i), status);
+		}
+		for (auto &[path, status] : m_deviceTree.trippedBreakers())
+			append(path, status);
+		return retval;
+	}
+Q_SIGNALS:
+	// Only declared for introspection, Subscriptions sends it to the subscriber only
+	void valuesChanged(uint id, TCDBus::ValueBatch batch);
+	// Sent by Connections after assigning a connection's target
+	void connectionApplied(QString targetPath, QDBusVariant value, TCDBus::Result<int> result);
+	// Devices were removed or added. 'removed' are the topmost removed nodes and 'added' the
+	// added nodes in preorder, so clients can patch the tree from flatDeviceTree
+	void deviceTreeChanged(QStringList removed, QVector<TCDBus::DeviceNode> added);
 private:
 	Q_OBJECT
 	Q_CLASSINFO("D-Bus Interface", "org.tuxclocker")
 
-	TreeNode<TCDBus::DeviceNode> m_rootNode;
 	QVector<TCDBus::FlatTreeNode<TCDBus::DeviceNode>> m_flatTree;
-};
-
-class StaticReadableAdaptor : public QDBusAbstractAdaptor {
-public:
-	StaticReadableAdaptor(QObject *obj, StaticReadable readable)
-	    : QDBusAbstractAdaptor(obj), m_readable(readable) {
-		qDBusRegisterMetaType<TCDBus::Result<QString>>();
-		// Unwrap the value and store in QDBusVariant
-		match(m_readable.value())(pattern(as<uint>(arg)) = [this](auto i) {
-			m_value = QDBusVariant(QVariant(i));
-		});
-
-		m_unit = (m_readable.unit().has_value())
-			     ? TCDBus::Result<QString>{false,
-				   QString::fromStdString(m_readable.unit().value())}
-			     : TCDBus::Result<QString>{true, ""};
+	QDBusConnection m_connection;
+	ReadableTable &m_readables;
+	Sampler &m_sampler;
+	DeviceTreeObject &m_deviceTree;
+	Subscriptions &m_subscriptions;
+	Telemetry &m_telemetry;
+	Connections &m_connections;
+	History &m_history;
+
+	void setFlatTree(TreeNode<TCDBus::DeviceNode> node) {
+		auto flatTree = std::move(node).toFlatTree();
+		m_flatTree.clear();
+		m_flatTree.reserve(flatTree.nodes.size());
+		for (auto &f_node : flatTree.nodes) {
+			QVector<int> childIndices(
+			    f_node.childIndices.begin(), f_node.childIndices.end());
+			m_flatTree.append({std::move(f_node.value), std::move(childIndices)});
+		}
 	}
-	QDBusVariant value_() { return m_value; }
-	TCDBus::Result<QString> unit_() { return m_unit; }
-private:
-	Q_OBJECT
-	Q_CLASSINFO("D-Bus Interface", "org.tuxclocker.StaticReadable")
-	Q_PROPERTY(TCDBus::Result<QString> unit READ unit_)
-	Q_PROPERTY(QDBusVariant value READ value_)
-
-	StaticReadable m_readable;
-	TCDBus::Result<QString> m_unit;
-	QDBusVariant m_value;
 };
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+/* Stops calls to a node that keeps failing, eg. a sysfs file of a GPU that has fallen off the
+   bus. Opens after a few failures in a row or one timeout. While open no calls are made until
+   the backoff has passed, then one trial call is let through. The backoff doubles every time
+   the trial fails, and a success closes the breaker again. */
+class CircuitBreaker {
+public:
+	using Clock = std::chrono::steady_clock;
+	// Same values as 'state' of CircuitBreakerState on the bus
+	enum class State : uint8_t {
+		Closed,
+		Open,
+		// Trial call allowed or in progress
+		HalfOpen
+	};
+	struct Status {
+		State state;
+		// Failures in a row, including timeouts
+		unsigned int failures;
+		// Earliest time of the next trial call when open
+		Clock::time_point retryAt;
+	};
+
+	// If a call should be made now
+	bool allow(Clock::time_point now) {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		switch (m_state) {
+		case State::Closed:
+			return true;
+		case State::Open:
+			if (now < m_retryAt)
+				return false;
+			m_state = State::HalfOpen;
+			return true;
+		case State::HalfOpen:
+			// Only one trial at a time
+			return false;
+		}
+		return false;
+	}
+	void succeeded() {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_state = State::Closed;
+		m_failures = 0;
+		m_backoff = Clock::duration::zero();
+	}
+	void failed(Clock::time_point now) {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_failures++;
+		if (m_state == State::HalfOpen || m_failures >= failureThreshold)
+			open(now);
+	}
+	// Hung calls cost a thread each, so one is enough
+	void timedOut(Clock::time_point now) {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_failures++;
+		open(now);
+	}
+	// Back to closed, eg. for a node added again after being removed
+	void reset() { succeeded(); }
+	Status status() const {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		return {m_state, m_failures, m_retryAt};
+	}
+private:
+	static constexpr unsigned int failureThreshold = 3;
+	static constexpr Clock::duration initialBackoff = std::chrono::seconds(1);
+	// Nodes that start working again are noticed within this time
+	static constexpr Clock::duration maxBackoff = std::chrono::minutes(1);
+
+	mutable std::mutex m_mutex;
+	State m_state = State::Closed;
+	unsigned int m_failures = 0;
+	Clock::duration m_backoff = Clock::duration::zero();
+	Clock::time_point m_retryAt;
+
+	// m_mutex needs to be held
+	void open(Clock::time_point now) {
+		m_backoff = (m_backoff == Clock::duration::zero())
+				? initialBackoff
+				: std::min<Clock::duration>(2 * m_backoff, maxBackoff);
+		m_state = State::Open;
+		m_retryAt = now + m_backoff;
+	}
+};
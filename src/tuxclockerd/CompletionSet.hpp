@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+/* Results of asynchronous calls started together, eg. the reads of a device, waited for with
+   one deadline. Completions arriving after wait() has given up are dropped and call the 'late'
+   callback given for them instead. */
+template <typename T> class CompletionSet {
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	CompletionSet() : m_state(std::make_shared<State>()) {}
+	// Completion to pass to the next call. Only the first result passed to it counts
+	std::function<void(T)> add(std::function<void()> late = {}) {
+		std::lock_guard<std::mutex> lock{m_state->mutex};
+		auto slot = m_state->results.size();
+		m_state->results.emplace_back();
+		m_state->completed.push_back(false);
+		m_state->late.push_back(std::move(late));
+		m_state->remaining++;
+		return [state = m_state, slot](T result) {
+			std::unique_lock<std::mutex> lock{state->mutex};
+			if (state->completed[slot])
+				return;
+			state->completed[slot] = true;
+			if (state->abandoned) {
+				auto late = state->late[slot];
+				lock.unlock();
+				if (late)
+					late();
+				return;
+			}
+			state->results[slot] = std::move(result);
+			if (--state->remaining == 0)
+				state->done.notify_one();
+		};
+	}
+	// Results in the order the completions were added, empty for calls that didn't complete
+	// in time. Zero waits without a deadline
+	std::vector<std::optional<T>> wait(Duration deadline) {
+		std::unique_lock<std::mutex> lock{m_state->mutex};
+		auto done = [&] { return m_state->remaining == 0; };
+		if (deadline == Duration::zero())
+			m_state->done.wait(lock, done);
+		else
+			m_state->done.wait_for(lock, deadline, done);
+		m_state->abandoned = true;
+		return m_state->results;
+	}
+private:
+	// Shared with the completions, which can be called after the set is destroyed
+	struct State {
+		std::mutex mutex;
+		std::condition_variable done;
+		std::vector<std::optional<T>> results;
+		std::vector<bool> completed;
+		std::vector<std::function<void()>> late;
+		size_t remaining = 0;
+		bool abandoned = false;
+	};
+	std::shared_ptr<State> m_state;
+};
@@ -0,0 +1,114 @@
+#include "Connections.hpp"
+
+#include <algorithm>
+#include <QDBusMessage>
+#include <QMetaObject>
+
+double interpolate(const QVector<QPointF> &points, double x) {
+	if (x <= points.first().x())
+		return points.first().y();
+	if (x >= points.last().x())
+		return points.last().y();
+
+	// First point right of x
+	auto right = std::upper_bound(points.begin(), points.end(), x,
+	    [](double x, const QPointF &point) { return x < point.x(); });
+	auto left = right - 1;
+	auto dx = right->x() - left->x();
+	if (dx == 0)
+		return right->y();
+	auto t = (x - left->x()) / dx;
+	return left->y() + t * (right->y() - left->y());
+}
+
+Connections::Connections(QDBusConnection connection, ReadableTable &readables,
+    Sampler &sampler, DeviceTreeObject &deviceTree, QObject *parent)
+    : QObject(parent), m_connection(connection), m_readables(readables), m_sampler(sampler),
+      m_deviceTree(deviceTree) {
+	m_sampler.addListener([this](const std::vector<int> &, qulonglong) {
+		QMetaObject::invokeMethod(this, [this] { onTick(); }, Qt::QueuedConnection);
+	});
+}
+
+bool Connections::set(TCDBus::ReadableConnection data) {
+	auto sourceIndex = m_readables.indexOf(data.sourcePath);
+	auto info = m_deviceTree.assignableInfo(data.targetPath);
+	if (!sourceIndex.has_value() || !info.has_value() || data.points.isEmpty() ||
+	    !std::holds_alternative<RangeInfo>(*info))
+		return false;
+
+	std::sort(data.points.begin(), data.points.end(),
+	    [](const QPointF &l, const QPointF &r) { return l.x() < r.x(); });
+	auto interval = m_sampler.clientInterval(data.interval);
+	auto integerTarget = std::holds_alternative<Range<int>>(std::get<RangeInfo>(*info));
+
+	remove(data.targetPath);
+	m_sampler.pin({*sourceIndex}, interval);
+	m_connections.emplace(data.targetPath, Connection{.data = data,
+						   .sourceIndex = *sourceIndex,
+						   .interval = interval,
+						   .integerTarget = integerTarget});
+	return true;
+}
+
+bool Connections::remove(const QString &targetPath) {
+	auto it = m_connections.find(targetPath);
+	if (it == m_connections.end())
+		return false;
+	m_sampler.unpin({it->second.sourceIndex}, it->second.interval);
+	m_connections.erase(it);
+	return true;
+}
+
+QVector<TCDBus::ReadableConnection> Connections::connections() const {
+	QVector<TCDBus::ReadableConnection> retval;
+	for (auto &[path, connection] : m_connections)
+		retval.append(connection.data);
+	return retval;
+}
+
+void Connections::onTick() {
+	for (auto &[path, connection] : m_connections) {
+		auto sample = m_sampler.peek(connection.sourceIndex);
+		if (sample.timestamp == 0 || sample.timestamp == connection.evaluated ||
+		    sample.error || connection.assigning)
+			continue;
+		evaluate(connection, sample);
+	}
+}
+
+void Connections::evaluate(Connection &connection, const Sample &sample) {
+	connection.evaluated = sample.timestamp;
+	auto value = interpolate(connection.data.points, sample.value);
+	if (connection.integerTarget)
+		value = static_cast<int>(value);
+	if (connection.assigned == value)
+		return;
+
+	connection.assigning = true;
+	auto targetPath = connection.data.targetPath;
+	auto target =
+	    connection.integerTarget ? QVariant{static_cast<int>(value)} : QVariant{value};
+	m_deviceTree.applyBatch({{targetPath, QDBusVariant(target)}}, [=](auto &results) {
+		// Called from the device's queue
+		QMetaObject::invokeMethod(
+		    this, [=] { onAssigned(targetPath, target, results.first()); },
+		    Qt::QueuedConnection);
+	});
+}
+
+void Connections::onAssigned(
+    const QString &targetPath, const QVariant &value, TCDBus::Result<int> result) {
+	auto signal = QDBusMessage::createSignal("/", "org.tuxclocker", "connectionApplied");
+	signal << targetPath << QVariant::fromValue(QDBusVariant(value))
+	       << QVariant::fromValue(result);
+	m_connection.send(signal);
+
+	auto it = m_connections.find(targetPath);
+	if (it == m_connections.end())
+		// Removed while assigning
+		return;
+	it->second.assigning = false;
+	// Failed values aren't retried until the target value changes
+	it->second.assigned = value.toDouble();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "DeviceTreeObject.hpp"
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+
+#include <map>
+#include <optional>
+#include <QDBusConnection>
+#include <QObject>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+
+Q_DECLARE_METATYPE(TCDBus::ReadableConnection)
+
+// Value of the piecewise linear function through 'points' at 'x'. 'points' are sorted by x
+double interpolate(const QVector<QPointF> &points, double x);
+
+/* Assignables connected to DynamicReadables, eg. fan speed following temperature. The
+   DynamicReadable is sampled at the connection's interval, and the Assignable is assigned the
+   interpolated value whenever it changes. The result of each assignment is broadcast as a
+   'connectionApplied' signal. Connections keep running without any clients. */
+class Connections : public QObject {
+public:
+	Connections(QDBusConnection connection, ReadableTable &readables, Sampler &sampler,
+	    DeviceTreeObject &deviceTree, QObject *parent = nullptr);
+	// Replaces the existing connection of the Assignable. Returns false if the target isn't a
+	// ranged Assignable, the source isn't a DynamicReadable or there are no points
+	bool set(TCDBus::ReadableConnection connection);
+	bool remove(const QString &targetPath);
+	QVector<TCDBus::ReadableConnection> connections() const;
+private:
+	struct Connection {
+		// Points sorted by x
+		TCDBus::ReadableConnection data;
+		int sourceIndex;
+		Sampler::Interval interval;
+		// Integer targets are only assigned when the truncated value changes
+		bool integerTarget;
+		// Timestamp of the sample the target was last computed from
+		qulonglong evaluated = 0;
+		std::optional<double> assigned;
+		// Only one assignment at a time is queued for the target
+		bool assigning = false;
+	};
+
+	QDBusConnection m_connection;
+	ReadableTable &m_readables;
+	Sampler &m_sampler;
+	DeviceTreeObject &m_deviceTree;
+	std::map<QString, Connection> m_connections;
+
+	// Main thread
+	void onTick();
+	void evaluate(Connection &connection, const Sample &sample);
+	void onAssigned(
+	    const QString &targetPath, const QVariant &value, TCDBus::Result<int> result);
+};
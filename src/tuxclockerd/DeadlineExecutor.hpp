@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+/* Runs calls that may hang, eg. reads of a faulting GPU, and stops waiting for them after a
+   deadline. A thread stuck in a call is left to finish it and a new thread is started for the
+   calls after it, up to a limit. Threads are detached, so a call that never returns doesn't
+   keep the executor from being destroyed. Idle threads above the minimum exit after a while. */
+class DeadlineExecutor {
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	explicit DeadlineExecutor(unsigned int minThreads, unsigned int maxThreads = 64)
+	    : m_state(std::make_shared<State>()) {
+		m_state->minThreads = minThreads;
+		m_state->maxThreads = std::max(maxThreads, 1u);
+	}
+	~DeadlineExecutor() {
+		{
+			std::lock_guard<std::mutex> lock{m_state->mutex};
+			m_state->stop = true;
+		}
+		m_state->condition.notify_all();
+	}
+	/* Result of 'call', or nothing if it didn't return within 'deadline'. 'late' is called
+	   once a call given up on isn't running anymore, from the thread that ran it or from this
+	   one if the call never started. It may be called after the executor is destroyed. */
+	template <typename T>
+	std::optional<T> run(
+	    std::function<T()> call, Duration deadline, std::function<void()> late = {}) {
+		struct Call {
+			std::mutex mutex;
+			std::condition_variable done;
+			std::optional<T> result;
+			bool started = false;
+			bool abandoned = false;
+		};
+		auto shared = std::make_shared<Call>();
+		push([shared, call = std::move(call), late] {
+			{
+				std::lock_guard<std::mutex> lock{shared->mutex};
+				if (shared->abandoned)
+					return;
+				shared->started = true;
+			}
+			auto result = call();
+			bool abandoned;
+			{
+				std::lock_guard<std::mutex> lock{shared->mutex};
+				abandoned = shared->abandoned;
+				if (!abandoned)
+					shared->result = std::move(result);
+			}
+			if (!abandoned)
+				shared->done.notify_one();
+			else if (late)
+				late();
+		});
+
+		std::unique_lock<std::mutex> lock{shared->mutex};
+		auto done = [&] { return shared->result.has_value(); };
+		if (shared->done.wait_for(lock, deadline, done))
+			return std::move(shared->result);
+		shared->abandoned = true;
+		auto started = shared->started;
+		lock.unlock();
+		// Still queued, it won't be run anymore
+		if (!started && late)
+			late();
+		return std::nullopt;
+	}
+private:
+	// Outlives the executor while calls are stuck
+	struct State {
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<std::function<void()>> tasks;
+		unsigned int threads = 0;
+		unsigned int idle = 0;
+		unsigned int minThreads;
+		unsigned int maxThreads;
+		bool stop = false;
+	};
+	std::shared_ptr<State> m_state;
+
+	void push(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock{m_state->mutex};
+			m_state->tasks.push_back(std::move(task));
+			// Threads stuck in calls aren't idle
+			if (m_state->tasks.size() > m_state->idle &&
+			    m_state->threads < m_state->maxThreads) {
+				m_state->threads++;
+				std::thread{[state = m_state] { work(state); }}.detach();
+				return;
+			}
+		}
+		m_state->condition.notify_one();
+	}
+	static void work(std::shared_ptr<State> state) {
+		constexpr auto idleTimeout = std::chrono::seconds(30);
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{state->mutex};
+				state->idle++;
+				auto woken = state->condition.wait_for(lock, idleTimeout,
+				    [&] { return state->stop || !state->tasks.empty(); });
+				state->idle--;
+				if (state->stop ||
+				    (!woken && state->threads > state->minThreads)) {
+					state->threads--;
+					return;
+				}
+				if (state->tasks.empty())
+					continue;
+				task = std::move(state->tasks.front());
+				state->tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
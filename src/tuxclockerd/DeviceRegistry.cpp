@@ -0,0 +1,311 @@
+#include "DeviceRegistry.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/netlink.h>
+#include <map>
+#include <QDebug>
+#include <QFileInfo>
+#include <QMetaObject>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <utility>
+
+// Settling time after the last event before plugins are scanned
+constexpr int settleMilliseconds = 500;
+
+// What changes with the devices of a subsystem in a recorded tree
+const std::map<QString, QStringList> subsystemPaths{
+    {"drm", {"/sys/class/drm"}},
+    {"cpu", {"/sys/devices/system/cpu", "/sys/devices/system/cpu/online"}},
+};
+
+QString devicePath(TreeView<DeviceNode> device) {
+	return "/" + QString::fromStdString(device.value().hash).replace(" ", "");
+}
+
+// Paths and interface types of the nodes of a device in preorder
+QStringList signature(TreeView<DeviceNode> device) {
+	QStringList retval;
+	std::function<void(TreeView<DeviceNode>, const QString &)> traverse;
+	traverse = [&](TreeView<DeviceNode> node, const QString &parentPath) {
+		auto path = parentPath + QString::fromStdString(node.value().hash).replace(" ", "");
+		auto &interface = node.value().interface;
+		retval.append(path + ":" +
+			      (interface.has_value() ? QString::number(interface->index()) : ""));
+		for (auto child : node.children())
+			traverse(child, path + "/");
+	};
+	traverse(device, "/");
+	return retval;
+}
+
+DeviceRegistry::DeviceRegistry(QDBusConnection connection, ReadableTable &readables,
+    Sampler &sampler, DeviceTreeObject &deviceTree, QObject *parent)
+    : QObject(parent), m_connection(connection), m_readables(readables), m_sampler(sampler),
+      m_deviceTree(deviceTree) {
+	m_settleTimer.setSingleShot(true);
+	m_settleTimer.setInterval(settleMilliseconds);
+	connect(&m_settleTimer, &QTimer::timeout, this, [this] {
+		for (size_t i = 0; i < m_plugins.size(); i++) {
+			auto &entry = m_plugins[i];
+			if (entry.subsystems.intersects(m_pendingRemovals))
+				entry.replace = true;
+			if (entry.subsystems.intersects(m_pendingSubsystems))
+				queueScan(i);
+		}
+		m_pendingSubsystems.clear();
+		m_pendingRemovals.clear();
+	});
+}
+
+DeviceRegistry::~DeviceRegistry() {
+	m_ueventNotifier.reset();
+	if (m_ueventSocket != -1)
+		close(m_ueventSocket);
+}
+
+void DeviceRegistry::addPlugin(boost::shared_ptr<DevicePlugin> plugin, TreeNode<DeviceNode> root) {
+	PluginDevices entry{.plugin = plugin};
+	for (auto &subsystem : plugin->hotplugSubsystems())
+		entry.subsystems.insert(QString::fromStdString(subsystem));
+
+	auto arena = std::make_shared<const Arena>(std::move(root));
+	Change change;
+	for (auto device : arena->root().children()) {
+		if (addDevice(device, change))
+			entry.devices.push_back({arena, device});
+	}
+	m_plugins.push_back(entry);
+}
+
+void DeviceRegistry::start() {
+	for (auto &entry : m_plugins) {
+		for (auto &device : entry.devices) {
+			auto path = devicePath(device.node);
+			if (!m_connection.registerVirtualObject(
+				path, &m_deviceTree, QDBusConnection::SubPath))
+				qDebug() << "Couldn't register object at path" << path
+					 << m_connection.lastError();
+		}
+	}
+	m_started = true;
+
+	auto fsRoot = qEnvironmentVariable("TUXCLOCKER_FS_ROOT");
+	if (fsRoot.isEmpty())
+		watchUevents();
+	else
+		watchFilesystem(fsRoot);
+}
+
+TreeNode<TCDBus::DeviceNode> DeviceRegistry::dbusTree() {
+	std::function<void(TreeView<DeviceNode>, const QString &, TreeNode<TCDBus::DeviceNode> *)>
+	    traverse;
+	traverse = [&](TreeView<DeviceNode> node, const QString &parentPath,
+		       TreeNode<TCDBus::DeviceNode> *dbusNode) {
+		auto path = parentPath + QString::fromStdString(node.value().hash).replace(" ", "");
+		dbusNode->appendChild(TCDBus::DeviceNode{m_deviceTree.interfaceName(path), path});
+		for (auto child : node.children())
+			traverse(child, path + "/", &dbusNode->childrenPtr()->back());
+	};
+	TreeNode<TCDBus::DeviceNode> root;
+	for (auto &entry : m_plugins) {
+		for (auto &device : entry.devices)
+			traverse(device.node, "/", &root);
+	}
+	return root;
+}
+
+bool DeviceRegistry::addDevice(TreeView<DeviceNode> device, Change &change) {
+	auto addedCount = change.added.size();
+	auto readableCount = change.addedReadables.size();
+	if (!addNode(device, "/", change)) {
+		qWarning() << "no room for the readables of" << devicePath(device)
+			   << "(--hotplug-readables)";
+		Change undone;
+		removeDevice(devicePath(device), undone);
+		change.added.resize(addedCount);
+		change.addedReadables.resize(readableCount);
+		return false;
+	}
+	if (m_started && !m_connection.registerVirtualObject(devicePath(device), &m_deviceTree,
+			     QDBusConnection::SubPath))
+		qDebug() << "Couldn't register object at path" << devicePath(device)
+			 << m_connection.lastError();
+	return true;
+}
+
+bool DeviceRegistry::addNode(
+    TreeView<DeviceNode> node, const QString &parentPath, Change &change) {
+	auto path = parentPath + QString::fromStdString(node.value().hash).replace(" ", "");
+	int readableIndex = -1;
+	auto &interface = node.value().interface;
+	if (interface.has_value() && std::holds_alternative<DynamicReadable>(*interface)) {
+		auto index = m_readables.append(path, std::get<DynamicReadable>(*interface));
+		if (!index.has_value())
+			return false;
+		readableIndex = *index;
+		if (m_started)
+			m_sampler.add(readableIndex);
+		change.addedReadables.push_back(readableIndex);
+	}
+	m_deviceTree.addNode(path, node.value(), readableIndex);
+	change.added.append({m_deviceTree.interfaceName(path), path});
+
+	for (auto child : node.children()) {
+		if (!addNode(child, path + "/", change))
+			return false;
+	}
+	return true;
+}
+
+void DeviceRegistry::removeDevice(const QString &path, Change &change) {
+	for (auto index : m_readables.subtreeIndices(path)) {
+		if (m_started)
+			m_sampler.remove(index);
+		m_readables.remove(index);
+	}
+	m_deviceTree.removeNode(path);
+	if (m_started)
+		m_connection.unregisterObject(path, QDBusConnection::UnregisterTree);
+	change.removed.append(path);
+}
+
+void DeviceRegistry::watchUevents() {
+	m_ueventSocket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+	    NETLINK_KOBJECT_UEVENT);
+	sockaddr_nl address{};
+	address.nl_family = AF_NETLINK;
+	// Events from the kernel, not the ones rebroadcast by udev
+	address.nl_groups = 1;
+	if (m_ueventSocket == -1 ||
+	    bind(m_ueventSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+		qWarning() << "couldn't listen for device events:" << strerror(errno);
+		return;
+	}
+	m_ueventNotifier =
+	    std::make_unique<QSocketNotifier>(m_ueventSocket, QSocketNotifier::Read);
+	connect(m_ueventNotifier.get(), &QSocketNotifier::activated, this,
+	    [this] { readUevents(); });
+}
+
+void DeviceRegistry::readUevents() {
+	char buffer[8192];
+	while (true) {
+		sockaddr_nl sender{};
+		socklen_t senderSize = sizeof(sender);
+		auto size = recvfrom(m_ueventSocket, buffer, sizeof(buffer) - 1, 0,
+		    reinterpret_cast<sockaddr *>(&sender), &senderSize);
+		if (size <= 0)
+			return;
+		// Anyone else could send made up events
+		if (sender.nl_pid != 0)
+			continue;
+		buffer[size] = '\0';
+
+		// 'action@devpath' and KEY=value fields separated by NULs
+		QString action, subsystem;
+		for (auto field = buffer; field < buffer + size; field += strlen(field) + 1) {
+			if (strncmp(field, "ACTION=", 7) == 0)
+				action = field + 7;
+			else if (strncmp(field, "SUBSYSTEM=", 10) == 0)
+				subsystem = field + 10;
+		}
+		// CPUs are onlined and offlined instead of added and removed
+		if (action == "add" || action == "remove" || action == "online" ||
+		    action == "offline")
+			onEvent(subsystem, action == "remove");
+	}
+}
+
+void DeviceRegistry::watchFilesystem(const QString &root) {
+	for (auto &[subsystem, paths] : subsystemPaths) {
+		for (auto &path : paths) {
+			if (QFileInfo::exists(root + path))
+				m_watcher.addPath(root + path);
+		}
+	}
+	auto onChange = [this, root](const QString &changed) {
+		// Files replaced by renaming aren't watched anymore
+		if (!m_watcher.files().contains(changed) && QFileInfo{changed}.isFile())
+			m_watcher.addPath(changed);
+		for (auto &[subsystem, paths] : subsystemPaths) {
+			// Recorded devices don't hold anything that could be removed
+			if (paths.contains(changed.mid(root.size())))
+				onEvent(subsystem, false);
+		}
+	};
+	connect(&m_watcher, &QFileSystemWatcher::directoryChanged, this, onChange);
+	connect(&m_watcher, &QFileSystemWatcher::fileChanged, this, onChange);
+}
+
+void DeviceRegistry::onEvent(const QString &subsystem, bool removed) {
+	m_pendingSubsystems.insert(subsystem);
+	if (removed)
+		m_pendingRemovals.insert(subsystem);
+	m_settleTimer.start();
+}
+
+void DeviceRegistry::queueScan(size_t pluginIndex) {
+	auto &entry = m_plugins[pluginIndex];
+	if (entry.scanning) {
+		entry.rescan = true;
+		return;
+	}
+	entry.scanning = true;
+	// Removals during the scan are handled by the next one
+	auto replace = std::exchange(entry.replace, false);
+	m_scanQueue.push([this, pluginIndex, plugin = entry.plugin, replace] {
+		// Moved into the arena here, off the main thread
+		auto root = std::make_shared<const Arena>(plugin->deviceRootNode());
+		// Events posted to the registry are dropped if it's destroyed
+		QMetaObject::invokeMethod(
+		    this,
+		    [this, pluginIndex, root, replace] { update(pluginIndex, root, replace); },
+		    Qt::QueuedConnection);
+	});
+}
+
+void DeviceRegistry::update(
+    size_t pluginIndex, std::shared_ptr<const Arena> root, bool replace) {
+	auto &entry = m_plugins[pluginIndex];
+	entry.scanning = false;
+	Change change{.previousSize = m_readables.size()};
+
+	std::map<QString, Device> previous;
+	for (auto &device : entry.devices)
+		previous.emplace(devicePath(device.node), device);
+
+	std::vector<Device> devices;
+	for (auto device : root->root().children()) {
+		auto path = devicePath(device);
+		auto it = previous.find(path);
+		if (it != previous.end()) {
+			if (!replace && signature(it->second.node) == signature(device)) {
+				// Keeps the registered nodes and the readables being sampled
+				devices.push_back(it->second);
+				previous.erase(it);
+				continue;
+			}
+			// Different nodes, eg. a core was onlined
+			removeDevice(path, change);
+			previous.erase(it);
+		}
+		if (addDevice(device, change))
+			devices.push_back({root, device});
+	}
+	for (auto &[path, device] : previous)
+		removeDevice(path, change);
+	entry.devices = devices;
+
+	if (!change.removed.isEmpty() || !change.added.isEmpty()) {
+		qDebug() << "devices changed:" << change.removed.size() << "removed,"
+			 << change.added.size() << "nodes added";
+		for (auto &listener : m_listeners)
+			listener(change);
+	}
+	if (entry.rescan) {
+		entry.rescan = false;
+		queueScan(pluginIndex);
+	}
+}
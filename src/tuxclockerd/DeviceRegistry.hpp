@@ -0,0 +1,114 @@
+#pragma once
+
+#include "DeviceTreeObject.hpp"
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
+#include <DBusTypes.hpp>
+#include <Device.hpp>
+#include <Plugin.hpp>
+#include <Tree.hpp>
+
+#include <functional>
+#include <memory>
+#include <QDBusConnection>
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+#include <string>
+#include <vector>
+
+using namespace TuxClocker;
+using namespace TuxClocker::Plugin;
+
+/* Adds the devices of plugins to the ReadableTable and the DeviceTreeObject and keeps them up
+   to date. After start(), kernel device events of the subsystems a plugin lists in
+   hotplugSubsystems() make the plugin build its tree again in a worker thread. The new tree is
+   compared to the current one per device, and only devices that appeared, disappeared or have
+   different nodes are registered or unregistered. After a remove event all devices of the
+   plugin are replaced instead, since a device created again, eg. by a driver reload, looks the
+   same but the old nodes refer to what was removed. Events come from the kernel's uevent socket,
+   or from watching the subsystems' directories under TUXCLOCKER_FS_ROOT when it's set. */
+class DeviceRegistry : public QObject {
+public:
+	// Nodes removed and added by one update. Removals happen first
+	struct Change {
+		// Topmost removed nodes, their children are removed with them
+		QStringList removed;
+		// In preorder, so parents come before their children
+		QVector<TCDBus::DeviceNode> added;
+		// DynamicReadables added, removed ones get their old index back
+		std::vector<int> addedReadables;
+		// Size of the ReadableTable before the update, indices from it on are new
+		int previousSize;
+	};
+	using Listener = std::function<void(const Change &change)>;
+
+	DeviceRegistry(QDBusConnection connection, ReadableTable &readables, Sampler &sampler,
+	    DeviceTreeObject &deviceTree, QObject *parent = nullptr);
+	~DeviceRegistry();
+	// Adds the devices under 'root' before start(), moving the nodes into an arena. Plugins
+	// keep the order they're added in
+	void addPlugin(boost::shared_ptr<DevicePlugin> plugin, TreeNode<DeviceNode> root);
+	// Registers the devices on the bus and starts watching for device events. Updates are
+	// applied from the event loop, after the Sampler has started
+	void start();
+	// Called from the main thread after each update
+	void addListener(Listener listener) { m_listeners.push_back(std::move(listener)); }
+	// All devices, as served by flatDeviceTree
+	TreeNode<TCDBus::DeviceNode> dbusTree();
+private:
+	using Arena = TreeArena<DeviceNode>;
+	// Top level node
+	struct Device {
+		// Shared by the devices from the same scan
+		std::shared_ptr<const Arena> arena;
+		TreeView<DeviceNode> node;
+	};
+	struct PluginDevices {
+		boost::shared_ptr<DevicePlugin> plugin;
+		QSet<QString> subsystems;
+		std::vector<Device> devices;
+		bool scanning = false;
+		// Events came while scanning
+		bool rescan = false;
+		// A remove event came since the last scan was started
+		bool replace = false;
+	};
+
+	QDBusConnection m_connection;
+	ReadableTable &m_readables;
+	Sampler &m_sampler;
+	DeviceTreeObject &m_deviceTree;
+	std::vector<PluginDevices> m_plugins;
+	std::vector<Listener> m_listeners;
+	bool m_started = false;
+	// Subsystems with events since the last scan
+	QSet<QString> m_pendingSubsystems;
+	// Subsystems with remove events since the last scan
+	QSet<QString> m_pendingRemovals;
+	// Events come in bursts, eg. a GPU has several drm nodes
+	QTimer m_settleTimer;
+	int m_ueventSocket = -1;
+	std::unique_ptr<QSocketNotifier> m_ueventNotifier;
+	QFileSystemWatcher m_watcher;
+	// Plugins build their trees here one at a time
+	ThreadPool m_scanQueue{1};
+
+	// Returns false and adds nothing if the ReadableTable is full
+	bool addDevice(TreeView<DeviceNode> device, Change &change);
+	bool addNode(TreeView<DeviceNode> node, const QString &parentPath, Change &change);
+	void removeDevice(const QString &path, Change &change);
+	void watchUevents();
+	void watchFilesystem(const QString &root);
+	void readUevents();
+	void onEvent(const QString &subsystem, bool removed);
+	void queueScan(size_t pluginIndex);
+	// Main thread, with the result of deviceRootNode() of the plugin
+	void update(size_t pluginIndex, std::shared_ptr<const Arena> root, bool replace);
+};
@@ -0,0 +1,499 @@
+#include "DeviceTreeObject.hpp"
+
+#include <map>
+#include <mutex>
+#include <patterns.hpp>
+#include <utility>
+#include <QDBusError>
+#include <QDBusMetaType>
+
+using namespace mpark::patterns;
+
+const QString nodeInterface = "org.tuxclocker.Node";
+const QString dynamicReadableInterface = "org.tuxclocker.DynamicReadable";
+const QString staticReadableInterface = "org.tuxclocker.StaticReadable";
+const QString assignableInterface = "org.tuxclocker.Assignable";
+const QString propertiesInterface = "org.freedesktop.DBus.Properties";
+
+const char *nodeIntrospection = "  <interface name=\"org.tuxclocker.Node\">\n"
+				"    <property name=\"hash\" type=\"s\" access=\"read\"/>\n"
+				"    <property name=\"name\" type=\"s\" access=\"read\"/>\n"
+				"  </interface>\n";
+
+const char *dynamicReadableIntrospection =
+    "  <interface name=\"org.tuxclocker.DynamicReadable\">\n"
+    "    <property name=\"unit\" type=\"(bs)\" access=\"read\"/>\n"
+    "    <method name=\"value\">\n"
+    "      <arg type=\"(bv)\" direction=\"out\"/>\n"
+    "    </method>\n"
+    "  </interface>\n";
+
+const char *staticReadableIntrospection =
+    "  <interface name=\"org.tuxclocker.StaticReadable\">\n"
+    "    <property name=\"unit\" type=\"(bs)\" access=\"read\"/>\n"
+    "    <property name=\"value\" type=\"v\" access=\"read\"/>\n"
+    "  </interface>\n";
+
+const char *assignableIntrospection =
+    "  <interface name=\"org.tuxclocker.Assignable\">\n"
+    "    <property name=\"unit\" type=\"(bs)\" access=\"read\"/>\n"
+    "    <property name=\"assignableInfo\" type=\"v\" access=\"read\"/>\n"
+    "    <method name=\"assign\">\n"
+    "      <arg type=\"v\" direction=\"in\"/>\n"
+    "      <arg type=\"(bi)\" direction=\"out\"/>\n"
+    "    </method>\n"
+    "    <method name=\"currentValue\">\n"
+    "      <arg type=\"(bv)\" direction=\"out\"/>\n"
+    "    </method>\n"
+    "  </interface>\n";
+
+TCDBus::Result<QString> toDBusUnit(std::optional<std::string> unit) {
+	if (unit.has_value())
+		return {false, QString::fromStdString(unit.value())};
+	return {true, QString("")};
+}
+
+QDBusVariant toDBusAssignableInfo(AssignableInfo info) {
+	QVariant a_info;
+	// Unwrap AssignableInfo :(
+	match(info)(
+	    pattern(as<RangeInfo>(arg)) =
+		[&](auto r_info) {
+			match(r_info)(
+			    pattern(as<Range<double>>(arg)) =
+				[&](auto dr) {
+					TCDBus::Range r{.min = QDBusVariant(QVariant(dr.min)),
+					    .max = QDBusVariant(QVariant(dr.max))};
+					a_info.setValue(r);
+				},
+			    pattern(as<Range<int>>(arg)) =
+				[&](auto ir) {
+					TCDBus::Range r{.min = QDBusVariant(QVariant(ir.min)),
+					    .max = QDBusVariant(QVariant(ir.max))};
+					a_info.setValue(r);
+				});
+		},
+	    pattern(as<EnumerationVec>(arg)) =
+		[&](auto enums) {
+			QVector<TCDBus::Enumeration> entries;
+			for (const auto &e : enums)
+				entries.append({e.key, QString::fromStdString(e.name)});
+			a_info.setValue(entries);
+		});
+	return QDBusVariant(a_info);
+}
+
+QDBusVariant toDBusValue(ReadableValue value) {
+	QVariant v;
+	match(value)(
+	    pattern(as<int>(arg)) = [&](auto i) { v = i; },
+	    pattern(as<uint>(arg)) = [&](auto u) { v = u; },
+	    pattern(as<double>(arg)) = [&](auto d) { v = d; },
+	    pattern(as<std::string>(arg)) = [&](auto s) { v = QString::fromStdString(s); });
+	return QDBusVariant(v);
+}
+
+// Value converted to the type the Assignable takes
+AssignmentArgument toAssignmentArgument(Assignable &assignable, const QVariant &v) {
+	AssignmentArgument retval = v.value<uint>();
+	match(assignable.assignableInfo())(
+	    pattern(as<RangeInfo>(arg)) =
+		[&](auto ri) {
+			match(ri)(
+			    pattern(as<Range<double>>(_)) = [&] { retval = v.value<double>(); },
+			    pattern(as<Range<int>>(_)) = [&] { retval = v.value<int>(); });
+		},
+	    pattern(as<EnumerationVec>(_)) = [&] { retval = v.value<uint>(); });
+	return retval;
+}
+
+TCDBus::Result<int> toAssignmentResult(std::optional<AssignmentError> error) {
+	TCDBus::Result<int> res{.error = false, 0};
+	// Check if optional contains error
+	if (error.has_value()) {
+		res.error = true;
+		res.value = static_cast<int>(error.value());
+	}
+	return res;
+}
+
+DeviceTreeObject::DeviceTreeObject(Sampler &sampler, QObject *parent)
+    : QDBusVirtualObject(parent), m_sampler(sampler) {
+	qDBusRegisterMetaType<TCDBus::Result<QDBusVariant>>();
+	qDBusRegisterMetaType<TCDBus::Result<QString>>();
+	qDBusRegisterMetaType<TCDBus::Result<int>>();
+	qDBusRegisterMetaType<TCDBus::Range>();
+	qDBusRegisterMetaType<TCDBus::Enumeration>();
+	qDBusRegisterMetaType<QVector<TCDBus::Enumeration>>();
+}
+
+void DeviceTreeObject::addNode(const QString &path, const DeviceNode &devNode, int readableIndex) {
+	// Not copyable because of the breaker
+	auto node = std::make_shared<Node>();
+	node->name = QString::fromStdString(devNode.name);
+	node->hash = path.section('/', -1);
+	node->interface = devNode.interface;
+	node->readableIndex = readableIndex;
+	node->device = -1;
+	node->unit = {true, QString("")};
+
+	if (devNode.interface.has_value()) {
+		match(*devNode.interface)(
+		    pattern(as<DynamicReadable>(arg)) =
+			[&](auto dr) {
+				node->interfaceName = dynamicReadableInterface;
+				node->unit = toDBusUnit(dr.unit());
+			},
+		    pattern(as<StaticReadable>(arg)) =
+			[&](auto sr) {
+				node->interfaceName = staticReadableInterface;
+				node->unit = toDBusUnit(sr.unit());
+				node->constantValue = toDBusValue(sr.value());
+			},
+		    pattern(as<Assignable>(arg)) =
+			[&](auto a) {
+				node->interfaceName = assignableInterface;
+				node->unit = toDBusUnit(a.unit());
+				node->constantValue = toDBusAssignableInfo(a.assignableInfo());
+				node->device = deviceQueueIndex(path);
+			});
+	}
+
+	auto parent = m_nodes.find(path.section('/', 0, -2));
+	if (parent != m_nodes.end())
+		parent.value()->children.append(node->hash);
+
+	m_nodes.insert(path, node);
+}
+
+void DeviceTreeObject::removeNode(const QString &path) {
+	auto it = m_nodes.find(path);
+	if (it == m_nodes.end())
+		return;
+	// Removing a child removes it from this list, so iterate over it taken out
+	const auto children = std::exchange(it.value()->children, {});
+	for (auto &child : children)
+		removeNode(path + "/" + child);
+	m_nodes.remove(path);
+
+	auto parent = m_nodes.find(path.section('/', 0, -2));
+	if (parent != m_nodes.end())
+		parent.value()->children.removeOne(path.section('/', -1));
+}
+
+int DeviceTreeObject::deviceQueueIndex(const QString &path) {
+	// Top level node, eg. /a7fb for /a7fb/37ca/d0fe
+	auto devicePath = path.section('/', 0, 1);
+	auto it = m_deviceIndices.find(devicePath);
+	if (it != m_deviceIndices.end())
+		return it.value();
+
+	m_deviceIndices.insert(devicePath, m_deviceQueues.size());
+	m_deviceQueues.push_back(std::make_unique<ThreadPool>(1));
+	m_stuckDevices.push_back(std::make_shared<std::atomic<int>>(0));
+	return m_deviceQueues.size() - 1;
+}
+
+QString DeviceTreeObject::interfaceName(const QString &path) const {
+	auto it = m_nodes.find(path);
+	return (it == m_nodes.end()) ? QString{} : it.value()->interfaceName;
+}
+
+QString DeviceTreeObject::name(const QString &path) const {
+	auto it = m_nodes.find(path);
+	return (it == m_nodes.end()) ? QString{} : it.value()->name;
+}
+
+std::vector<std::pair<QString, CircuitBreaker::Status>> DeviceTreeObject::trippedBreakers() const {
+	std::vector<std::pair<QString, CircuitBreaker::Status>> retval;
+	for (auto it = m_nodes.begin(); it != m_nodes.end(); it++) {
+		if (it.value()->device == -1)
+			continue;
+		auto status = it.value()->breaker.status();
+		if (status.state != CircuitBreaker::State::Closed)
+			retval.push_back({it.key(), status});
+	}
+	return retval;
+}
+
+std::optional<AssignableInfo> DeviceTreeObject::assignableInfo(const QString &path) {
+	auto it = m_nodes.find(path);
+	if (it == m_nodes.end() || it.value()->device == -1)
+		return std::nullopt;
+	return std::get<Assignable>(*it.value()->interface).assignableInfo();
+}
+
+QString DeviceTreeObject::introspect(const QString &path) const {
+	auto it = m_nodes.find(path);
+	if (it == m_nodes.end())
+		return QString{};
+
+	auto &node = *it.value();
+	QString xml = nodeIntrospection;
+	if (node.interfaceName == dynamicReadableInterface)
+		xml += dynamicReadableIntrospection;
+	else if (node.interfaceName == staticReadableInterface)
+		xml += staticReadableIntrospection;
+	else if (node.interfaceName == assignableInterface)
+		xml += assignableIntrospection;
+
+	// Child nodes have to be listed here when registered with SubPath
+	for (auto &child : node.children)
+		xml += QString{"  <node name=\"%1\"/>\n"}.arg(child);
+	return xml;
+}
+
+bool DeviceTreeObject::handleMessage(
+    const QDBusMessage &message, const QDBusConnection &connection) {
+	auto it = m_nodes.find(message.path());
+	if (it == m_nodes.end())
+		return false;
+	auto &node = *it.value();
+
+	if (message.interface() == propertiesInterface)
+		return handleProperties(node, message, connection);
+	if (!node.interface.has_value() || node.interfaceName.isEmpty() ||
+	    (!message.interface().isEmpty() && message.interface() != node.interfaceName))
+		return false;
+
+	if (std::holds_alternative<Assignable>(*node.interface))
+		return queueAssignableCall(it.value(), message, connection);
+
+	auto member = message.member();
+	auto args = message.arguments();
+	QVariant reply;
+	match(*node.interface)(
+	    pattern(as<DynamicReadable>(_)) =
+		[&] {
+			if (member != "value" || !args.isEmpty())
+				return;
+			// Served from the Sampler's snapshot instead of reading the hardware
+			auto sample = m_sampler.latest(node.readableIndex);
+			reply = QVariant::fromValue(TCDBus::Result<QDBusVariant>{
+			    sample.error != 0, QDBusVariant(toVariant(sample))});
+		},
+	    pattern(_) = [] {});
+
+	if (!reply.isValid())
+		return false;
+	return connection.send(message.createReply(reply));
+}
+
+bool DeviceTreeObject::queueAssignableCall(std::shared_ptr<Node> node,
+    const QDBusMessage &message, const QDBusConnection &connection) {
+	auto member = message.member();
+	auto args = message.arguments();
+	if (!(member == "currentValue" && args.isEmpty()) &&
+	    !(member == "assign" && args.size() == 1))
+		return false;
+
+	// Replied to from the device's queue once the hardware has been accessed
+	m_deviceQueues[node->device]->push([=, stuck = m_stuckDevices[node->device]] {
+		auto &assignable = std::get<Assignable>(*node->interface);
+		QVariant reply;
+		if (member == "currentValue")
+			reply = QVariant::fromValue(currentValue(node, stuck));
+		else
+			reply = QVariant::fromValue(
+			    assign(assignable, args[0].value<QDBusVariant>().variant()));
+		// Sending is thread safe
+		connection.send(message.createReply(reply));
+	});
+	return true;
+}
+
+std::optional<QVariant> DeviceTreeObject::property(
+    const Node &node, const QString &interface, const QString &name) const {
+	if (interface == nodeInterface) {
+		if (name == "name")
+			return node.name;
+		if (name == "hash")
+			return node.hash;
+		return std::nullopt;
+	}
+	if (interface.isEmpty() || interface != node.interfaceName)
+		return std::nullopt;
+
+	if (name == "unit")
+		return QVariant::fromValue(node.unit);
+	if ((interface == staticReadableInterface && name == "value") ||
+	    (interface == assignableInterface && name == "assignableInfo"))
+		return QVariant::fromValue(node.constantValue);
+	return std::nullopt;
+}
+
+QVariantMap DeviceTreeObject::allProperties(const Node &node, const QString &interface) const {
+	QVariantMap retval;
+	for (auto &name : {"name", "hash", "unit", "value", "assignableInfo"}) {
+		auto value = property(node, interface, name);
+		if (value.has_value())
+			retval.insert(name, *value);
+	}
+	return retval;
+}
+
+bool DeviceTreeObject::handleProperties(
+    const Node &node, const QDBusMessage &message, const QDBusConnection &connection) {
+	auto args = message.arguments();
+	auto member = message.member();
+
+	if (member == "Get" && args.size() == 2) {
+		auto value = property(node, args[0].toString(), args[1].toString());
+		if (!value.has_value())
+			return connection.send(message.createErrorReply(QDBusError::InvalidArgs,
+			    QString{"No such property %1"}.arg(args[1].toString())));
+		return connection.send(
+		    message.createReply(QVariant::fromValue(QDBusVariant(*value))));
+	}
+	if (member == "GetAll" && args.size() == 1)
+		return connection.send(
+		    message.createReply(allProperties(node, args[0].toString())));
+	if (member == "Set" && args.size() == 3)
+		return connection.send(
+		    message.createErrorReply("org.freedesktop.DBus.Error.PropertyReadOnly",
+			QString{"Property %1 is read-only"}.arg(args[1].toString())));
+	return false;
+}
+
+TCDBus::Result<QDBusVariant> DeviceTreeObject::currentValue(
+    std::shared_ptr<Node> node, std::shared_ptr<std::atomic<int>> stuck) {
+	// Indicate error by default
+	TCDBus::Result<QDBusVariant> retval{.error = true, .value = QDBusVariant(QVariant(0))};
+	if (*stuck > 0 || !node->breaker.allow(CircuitBreaker::Clock::now()))
+		return retval;
+
+	std::optional<std::optional<AssignmentArgument>> value;
+	auto &assignable = std::get<Assignable>(*node->interface);
+	auto deadline = m_sampler.readDeadline();
+	auto late = [stuck] { (*stuck)--; };
+	if (deadline == Sampler::Interval::zero()) {
+		value = assignable.currentValue();
+	} else if (assignable.isAsync()) {
+		CompletionSet<std::optional<AssignmentArgument>> completions;
+		assignable.currentValueAsync(completions.add(late));
+		value = completions.wait(deadline)[0];
+	} else {
+		// The node is kept alive by the call in case it returns after being removed
+		value = m_executor.run<std::optional<AssignmentArgument>>(
+		    [node] { return std::get<Assignable>(*node->interface).currentValue(); },
+		    deadline, late);
+	}
+	if (!value.has_value()) {
+		// Counted, since the late callback can run before this
+		(*stuck)++;
+		node->breaker.timedOut(CircuitBreaker::Clock::now());
+		return retval;
+	}
+	if (value->has_value())
+		node->breaker.succeeded();
+	else
+		node->breaker.failed(CircuitBreaker::Clock::now());
+
+	match(*value)(
+	    pattern(some(arg)) =
+		[&](auto aa) {
+			retval.error = false;
+			match(aa)(
+			    pattern(as<double>(arg)) =
+				[&](auto d) { retval.value = QDBusVariant(QVariant(d)); },
+			    pattern(as<int>(arg)) =
+				[&](auto i) { retval.value = QDBusVariant(QVariant(i)); },
+			    pattern(as<uint>(arg)) =
+				[&](auto u) { retval.value = QDBusVariant(QVariant(u)); });
+		},
+	    pattern(none) = [] {});
+	return retval;
+}
+
+TCDBus::Result<int> DeviceTreeObject::assign(Assignable &assignable, const QVariant &v) {
+	return toAssignmentResult(assignable.assign(toAssignmentArgument(assignable, v)));
+}
+
+void DeviceTreeObject::applyBatch(
+    const QVector<TCDBus::BatchAssignment> &assignments, BatchReply reply) {
+	struct State {
+		std::mutex mutex;
+		QVector<TCDBus::Result<int>> results;
+		int remainingDevices;
+	};
+	auto state = std::make_shared<State>();
+	// Nonexistent paths and other than Assignables
+	state->results.fill(toAssignmentResult(AssignmentError::InvalidArgument),
+	    assignments.size());
+
+	// Indices of the assignments and their nodes per device
+	std::map<int, std::vector<int>> deviceAssignments;
+	std::map<int, std::vector<std::pair<std::shared_ptr<Node>, QVariant>>> deviceNodes;
+	for (int i = 0; i < assignments.size(); i++) {
+		auto it = m_nodes.find(assignments[i].path);
+		if (it == m_nodes.end() || it.value()->device == -1)
+			continue;
+		auto device = it.value()->device;
+		deviceAssignments[device].push_back(i);
+		deviceNodes[device].push_back({it.value(), assignments[i].value.variant()});
+	}
+	if (deviceNodes.empty()) {
+		reply(state->results);
+		return;
+	}
+
+	state->remainingDevices = deviceNodes.size();
+	for (auto &[device, nodes] : deviceNodes) {
+		m_deviceQueues[device]->push([=, indices = deviceAssignments[device],
+						 nodes = nodes] {
+			auto results = applyDeviceBatch(nodes);
+			bool done;
+			{
+				std::lock_guard<std::mutex> lock{state->mutex};
+				for (size_t i = 0; i < indices.size(); i++)
+					state->results[indices[i]] = results[i];
+				done = --state->remainingDevices == 0;
+			}
+			if (done)
+				reply(state->results);
+		});
+	}
+}
+
+QVector<TCDBus::Result<int>> DeviceTreeObject::applyDeviceBatch(
+    const std::vector<std::pair<std::shared_ptr<Node>, QVariant>> &assignments) {
+	QVector<TCDBus::Result<int>> results(assignments.size());
+	auto assignable = [&](size_t i) -> Assignable & {
+		return std::get<Assignable>(*assignments[i].first->interface);
+	};
+
+	// In request order, so a later value for the same setting wins. Consecutive entries of
+	// the same Transaction are committed together
+	for (size_t i = 0; i < assignments.size();) {
+		auto transaction = assignable(i).transaction();
+		if (!transaction) {
+			results[i] = assign(assignable(i), assignments[i].second);
+			i++;
+			continue;
+		}
+		auto end = i + 1;
+		while (end < assignments.size() && assignable(end).transaction() == transaction)
+			end++;
+
+		auto beginError = transaction->begin();
+		std::vector<size_t> staged;
+		for (; i < end; i++) {
+			if (beginError.has_value()) {
+				results[i] = toAssignmentResult(beginError);
+				continue;
+			}
+			auto &target = assignable(i);
+			results[i] = toAssignmentResult(
+			    target.stage(toAssignmentArgument(target, assignments[i].second)));
+			if (!results[i].error)
+				staged.push_back(i);
+		}
+		if (staged.empty())
+			continue;
+		// Staged changes succeed or fail together
+		auto commitError = transaction->commit();
+		for (auto j : staged)
+			results[j] = toAssignmentResult(commitError);
+	}
+	return results;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "CircuitBreaker.hpp"
+#include "CompletionSet.hpp"
+#include "DeadlineExecutor.hpp"
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
+#include <DBusTypes.hpp>
+#include <Device.hpp>
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusVariant>
+#include <memory>
+#include <QDBusVirtualObject>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <vector>
+
+Q_DECLARE_METATYPE(TCDBus::Result<QDBusVariant>)
+Q_DECLARE_METATYPE(TCDBus::Result<QString>)
+Q_DECLARE_METATYPE(TCDBus::Result<int>)
+Q_DECLARE_METATYPE(TCDBus::Range)
+Q_DECLARE_METATYPE(TCDBus::Enumeration)
+
+/* Serves the device nodes from a flat table instead of a QObject with adaptors per node.
+   Registered with SubPath at the path of every top level device node, and implements the
+   same interfaces on each node as documented in doc/DBus.md. Calls to Assignables are run
+   in a queue per device and replied to when done, so a slow write doesn't hold up reads or
+   writes of other devices. currentValue() has the same read deadline and kind of
+   CircuitBreaker per node as the Sampler has for DynamicReadables. */
+class DeviceTreeObject : public QDBusVirtualObject {
+public:
+	explicit DeviceTreeObject(Sampler &sampler, QObject *parent = nullptr);
+	// Parents need to be added before their children. 'readableIndex' is the index of a
+	// DynamicReadable in ReadableTable
+	void addNode(const QString &path, const DeviceNode &node, int readableIndex = -1);
+	// Removes the node and its children. Calls to Assignables already queued still finish
+	void removeNode(const QString &path);
+	// Name of the interface the node at 'path' implements besides org.tuxclocker.Node
+	QString interfaceName(const QString &path) const;
+	// Empty if there's no node at 'path'
+	QString name(const QString &path) const;
+	int nodeCount() const { return m_nodes.size(); }
+	// Empty if there's no Assignable at 'path'
+	std::optional<AssignableInfo> assignableInfo(const QString &path);
+	// Paths and states of the breakers of Assignables that aren't closed
+	std::vector<std::pair<QString, CircuitBreaker::Status>> trippedBreakers() const;
+	using BatchReply = std::function<void(const QVector<TCDBus::Result<int>> &results)>;
+	// Assigns the values in one task per device, so changes to Assignables sharing a
+	// Transaction are committed once. 'reply' is called from a device queue with the results in
+	// the same order, when all of them are done
+	void applyBatch(const QVector<TCDBus::BatchAssignment> &assignments, BatchReply reply);
+
+	QString introspect(const QString &path) const override;
+	bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override;
+private:
+	struct Node {
+		QString name;
+		QString hash;
+		// Empty if the node only implements org.tuxclocker.Node
+		QString interfaceName;
+		std::optional<DeviceInterface> interface;
+		int readableIndex;
+		// Index of the device's queue for Assignables
+		int device;
+		TCDBus::Result<QString> unit;
+		// Value of 'assignableInfo' for Assignables and 'value' for StaticReadables
+		QDBusVariant constantValue;
+		QStringList children;
+		// Of currentValue() calls of Assignables
+		CircuitBreaker breaker;
+	};
+
+	Sampler &m_sampler;
+	// Shared with the device queues so removing a node doesn't pull it from under a call
+	QHash<QString, std::shared_ptr<Node>> m_nodes;
+	// Used from the device queues, so it needs to outlive them
+	DeadlineExecutor m_executor{1};
+	// Assignments to a device are run in order, one at a time
+	std::vector<std::unique_ptr<ThreadPool>> m_deviceQueues;
+	// currentValue() calls per device given up on that haven't returned yet
+	std::vector<std::shared_ptr<std::atomic<int>>> m_stuckDevices;
+	QHash<QString, int> m_deviceIndices;
+
+	std::optional<QVariant> property(
+	    const Node &node, const QString &interface, const QString &name) const;
+	QVariantMap allProperties(const Node &node, const QString &interface) const;
+	// Creates the queue of the node's device if it doesn't exist
+	int deviceQueueIndex(const QString &path);
+	bool queueAssignableCall(std::shared_ptr<Node> node, const QDBusMessage &message,
+	    const QDBusConnection &connection);
+	bool handleProperties(
+	    const Node &node, const QDBusMessage &message, const QDBusConnection &connection);
+	// Needs to run in the node's device queue
+	TCDBus::Result<QDBusVariant> currentValue(
+	    std::shared_ptr<Node> node, std::shared_ptr<std::atomic<int>> stuck);
+	TCDBus::Result<int> assign(Assignable &assignable, const QVariant &value);
+	// Assignments of one device, as nodes and values. Needs to run in its queue
+	QVector<TCDBus::Result<int>> applyDeviceBatch(
+	    const std::vector<std::pair<std::shared_ptr<Node>, QVariant>> &assignments);
+};
@@ -0,0 +1,198 @@
+#include "History.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <QStringList>
+
+constexpr size_t lanes = 4;
+constexpr qulonglong nanosecondsPerSecond = 1000000000;
+
+void HistoryEntries::resize(size_t size) {
+	starts.resize(size);
+	mins.resize(size);
+	maxs.resize(size);
+	sums.resize(size);
+	counts.resize(size);
+}
+
+// Folds values [begin, end) with 'op', keeping an accumulator per lane
+template <typename Op>
+double reduce(const std::vector<double> &values, size_t begin, size_t end, double init, Op op) {
+	double acc[lanes];
+	std::fill(acc, acc + lanes, init);
+	auto i = begin;
+	for (; i + lanes <= end; i += lanes) {
+		for (size_t l = 0; l < lanes; l++)
+			acc[l] = op(acc[l], values[i + l]);
+	}
+	for (; i < end; i++)
+		acc[0] = op(acc[0], values[i]);
+	for (size_t l = 1; l < lanes; l++)
+		acc[0] = op(acc[0], acc[l]);
+	return acc[0];
+}
+
+TCDBus::HistoryBucket aggregate(const HistoryEntries &entries, size_t begin, size_t end) {
+	auto add = [](double a, double b) { return a + b; };
+	// Written as comparisons so they map to min/max instructions
+	auto min = [](double a, double b) { return b < a ? b : a; };
+	auto max = [](double a, double b) { return b > a ? b : a; };
+
+	auto count = reduce(entries.counts, begin, end, 0, add);
+	if (count == 0) {
+		auto nan = std::numeric_limits<double>::quiet_NaN();
+		return {nan, nan, nan, 0};
+	}
+	auto infinity = std::numeric_limits<double>::infinity();
+	return {
+	    .min = reduce(entries.mins, begin, end, infinity, min),
+	    .max = reduce(entries.maxs, begin, end, -infinity, max),
+	    .average = reduce(entries.sums, begin, end, 0, add) / count,
+	    .count = static_cast<uint>(count),
+	};
+}
+
+// One more slot than the capacity for the entry being accumulated
+HistoryTier::HistoryTier(qulonglong resolution, size_t capacity) : m_resolution(resolution) {
+	m_ring.resize(capacity + 1);
+}
+
+void HistoryTier::add(qulonglong timestamp, double value) {
+	auto start = timestamp - timestamp % m_resolution;
+	auto slots = m_ring.size();
+	if (m_open && m_ring.starts[m_next] != start) {
+		m_next = (m_next + 1) % slots;
+		m_size = std::min(m_size + 1, slots - 1);
+		m_open = false;
+	}
+	if (!m_open) {
+		m_ring.starts[m_next] = start;
+		m_ring.mins[m_next] = value;
+		m_ring.maxs[m_next] = value;
+		m_ring.sums[m_next] = 0;
+		m_ring.counts[m_next] = 0;
+		m_open = true;
+	}
+	m_ring.mins[m_next] = std::min(m_ring.mins[m_next], value);
+	m_ring.maxs[m_next] = std::max(m_ring.maxs[m_next], value);
+	m_ring.sums[m_next] += value;
+	m_ring.counts[m_next]++;
+}
+
+std::optional<qulonglong> HistoryTier::oldest() const {
+	if (m_size == 0 && !m_open)
+		return std::nullopt;
+	return m_ring.starts[(m_next + m_ring.size() - m_size) % m_ring.size()];
+}
+
+HistoryEntries HistoryTier::range(qulonglong from, qulonglong to) const {
+	HistoryEntries retval;
+	auto slots = m_ring.size();
+	auto total = m_size + (m_open ? 1 : 0);
+	for (size_t i = 0; i < total; i++) {
+		auto slot = (m_next + slots - m_size + i) % slots;
+		auto start = m_ring.starts[slot];
+		if (start < from || start >= to)
+			continue;
+		retval.starts.push_back(start);
+		retval.mins.push_back(m_ring.mins[slot]);
+		retval.maxs.push_back(m_ring.maxs[slot]);
+		retval.sums.push_back(m_ring.sums[slot]);
+		retval.counts.push_back(m_ring.counts[slot]);
+	}
+	return retval;
+}
+
+std::optional<std::vector<History::TierConfig>> History::parseTiers(const QString &string) {
+	std::vector<TierConfig> retval;
+	for (auto &tier : string.split(',', Qt::SkipEmptyParts)) {
+		auto parts = tier.split(':');
+		if (parts.size() != 2)
+			return std::nullopt;
+		bool resolutionOk, capacityOk;
+		auto resolution = parts[0].toUInt(&resolutionOk);
+		auto capacity = parts[1].toUInt(&capacityOk);
+		if (!resolutionOk || !capacityOk || resolution == 0 || capacity == 0)
+			return std::nullopt;
+		retval.push_back({resolution, capacity});
+	}
+	// Queries look for the finest tier first
+	std::sort(retval.begin(), retval.end(),
+	    [](auto &a, auto &b) { return a.resolution < b.resolution; });
+	return retval;
+}
+
+History::History(ReadableTable &readables, Sampler &sampler, std::vector<TierConfig> tiers,
+    QObject *parent)
+    : QObject(parent), m_readables(readables), m_tierConfigs(tiers) {
+	m_tiers.resize(readables.size());
+	if (m_tierConfigs.empty())
+		return;
+
+	sampler.addListener([this, &sampler](const std::vector<int> &indices, qulonglong) {
+		std::lock_guard<std::mutex> lock{m_mutex};
+		for (auto index : indices) {
+			auto sample = sampler.peek(index);
+			if (sample.error)
+				continue;
+			if (index >= m_tiers.size())
+				// Added after start
+				m_tiers.resize(index + 1);
+			auto &tiers = m_tiers[index];
+			for (size_t i = tiers.size(); i < m_tierConfigs.size(); i++) {
+				auto &config = m_tierConfigs[i];
+				auto resolution = config.resolution * nanosecondsPerSecond;
+				tiers.emplace_back(resolution, config.capacity);
+			}
+			for (auto &tier : tiers)
+				tier.add(sample.timestamp, sample.value);
+		}
+	});
+}
+
+std::optional<QVector<TCDBus::HistoryBucket>> History::query(
+    const QString &path, qulonglong from, qulonglong to, qulonglong resolution) {
+	auto index = m_readables.indexOf(path);
+	if (!index.has_value())
+		return std::nullopt;
+	if (to == 0)
+		to = monotonicTimestamp();
+	if (resolution == 0 || from >= to)
+		return std::nullopt;
+	auto bucketCount = (to - from + resolution - 1) / resolution;
+	if (bucketCount > maxBuckets)
+		return std::nullopt;
+
+	HistoryEntries entries;
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		// Falls back to the tier reaching furthest back
+		const HistoryTier *chosen = nullptr;
+		auto &tiers = (*index < m_tiers.size()) ? m_tiers[*index] : m_noTiers;
+		for (auto &tier : tiers) {
+			auto oldest = tier.oldest();
+			if (!oldest.has_value())
+				continue;
+			if (!chosen || *oldest < *chosen->oldest())
+				chosen = &tier;
+			if (*oldest <= from)
+				break;
+		}
+		if (chosen)
+			entries = chosen->range(from, to);
+	}
+
+	QVector<TCDBus::HistoryBucket> retval;
+	retval.reserve(bucketCount);
+	size_t begin = 0;
+	for (qulonglong i = 0; i < bucketCount; i++) {
+		auto bucketEnd = from + (i + 1) * resolution;
+		auto end = begin;
+		while (end < entries.size() && entries.starts[end] < bucketEnd)
+			end++;
+		retval.append(aggregate(entries, begin, end));
+		begin = end;
+	}
+	return retval;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+
+#include <DBusTypes.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+// Aggregated samples, each field in its own array so ranges of them are contiguous
+struct HistoryEntries {
+	// Start of the time range each entry covers
+	std::vector<qulonglong> starts;
+	std::vector<double> mins;
+	std::vector<double> maxs;
+	std::vector<double> sums;
+	std::vector<double> counts;
+
+	void resize(size_t size);
+	size_t size() const { return starts.size(); }
+};
+
+// Min, max and average of entries [begin, end). The loops keep independent accumulators so
+// the compiler can vectorize them
+TCDBus::HistoryBucket aggregate(const HistoryEntries &entries, size_t begin, size_t end);
+
+/* Ring of aggregates at a fixed resolution, the oldest overwritten first. Samples are
+   accumulated into the entry for their time range until a sample for a later range comes. */
+class HistoryTier {
+public:
+	// 'resolution' in nanoseconds
+	HistoryTier(qulonglong resolution, size_t capacity);
+	void add(qulonglong timestamp, double value);
+	qulonglong resolution() const { return m_resolution; }
+	// Start of the oldest entry including the one being accumulated, if any
+	std::optional<qulonglong> oldest() const;
+	// Entries starting in [from, to) in time order
+	HistoryEntries range(qulonglong from, qulonglong to) const;
+private:
+	qulonglong m_resolution;
+	HistoryEntries m_ring;
+	// Where the next finished entry goes
+	size_t m_next = 0;
+	size_t m_size = 0;
+	// Entry being accumulated, at m_next, not counted in m_size
+	bool m_open = false;
+};
+
+/* Keeps the history of every sampled DynamicReadable in tiers of increasing resolution, so
+   clients can get trends from before they started. Memory use is fixed per readable, and only
+   readables the Sampler samples are allocated any. */
+class History : public QObject {
+public:
+	struct TierConfig {
+		// Seconds
+		uint resolution;
+		size_t capacity;
+	};
+	// Parses eg. "1:600,60:360" for 10 minutes at 1 s and 6 hours at 1 min resolution
+	static std::optional<std::vector<TierConfig>> parseTiers(const QString &string);
+	// Limit of buckets in a query
+	static constexpr qulonglong maxBuckets = 100000;
+
+	History(ReadableTable &readables, Sampler &sampler, std::vector<TierConfig> tiers,
+	    QObject *parent = nullptr);
+	/* Min, max and average of the readable at 'path' in 'resolution' long buckets from 'from'
+	   to 'to', in nanoseconds of monotonicTimestamp(). The finest tier that reaches back to
+	   'from' is used. Nullopt if 'path' doesn't exist or the range is invalid. */
+	std::optional<QVector<TCDBus::HistoryBucket>> query(
+	    const QString &path, qulonglong from, qulonglong to, qulonglong resolution);
+private:
+	ReadableTable &m_readables;
+	std::vector<TierConfig> m_tierConfigs;
+	// Protects the tiers, which are written from the sampling thread
+	std::mutex m_mutex;
+	// Empty until the readable is first sampled. Grows with readables added after start
+	std::vector<std::vector<HistoryTier>> m_tiers;
+	const std::vector<HistoryTier> m_noTiers;
+};
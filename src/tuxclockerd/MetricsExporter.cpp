@@ -0,0 +1,147 @@
+#include "MetricsExporter.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <QHostAddress>
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <type_traits>
+
+const std::string header = "# TYPE tuxclocker_value gauge\n"
+			   "# HELP tuxclocker_value Latest sample of a DynamicReadable.\n";
+const std::string coalescingHeader =
+    "# TYPE tuxclocker_read_coalescing counter\n"
+    "# HELP tuxclocker_read_coalescing Direct reads served from a recent sample (hit) or not.\n";
+const std::string footer = "# EOF\n";
+// Scrapers send small requests, anything bigger is dropped
+constexpr int maxRequestSize = 8192;
+
+std::string escapeLabelValue(const QString &value) {
+	std::string retval;
+	for (auto c : value.toStdString()) {
+		if (c == '\\' || c == '"')
+			retval += '\\';
+		if (c == '\n') {
+			retval += "\\n";
+			continue;
+		}
+		retval += c;
+	}
+	return retval;
+}
+
+MetricsExporter::MetricsExporter(ReadableTable &readables, Sampler &sampler,
+    const DeviceTreeObject &deviceTree, QObject *parent)
+    : QObject(parent), m_readables(readables), m_sampler(sampler), m_deviceTree(deviceTree) {
+	addSeries();
+	// Nothing is sampled yet
+	m_body = QByteArray::fromStdString(header + footer);
+
+	sampler.addListener([this](const std::vector<int> &, qulonglong) { render(); });
+
+	connect(&m_localServer, &QLocalServer::newConnection, this, [this] {
+		while (auto socket = m_localServer.nextPendingConnection())
+			serve(socket);
+	});
+	connect(&m_tcpServer, &QTcpServer::newConnection, this, [this] {
+		while (auto socket = m_tcpServer.nextPendingConnection())
+			serve(socket);
+	});
+}
+
+void MetricsExporter::addSeries() {
+	auto label = [](const std::string &name, const QString &value) {
+		return name + "=\"" + escapeLabelValue(value) + "\"";
+	};
+	std::lock_guard<std::mutex> lock{m_seriesMutex};
+	for (int i = m_series.size(); i < m_readables.size(); i++) {
+		// Paths are made of node hashes, eg. /<device>/<group>/<node>
+		auto &path = m_readables.path(i);
+		auto devicePath = path.section('/', 0, 1);
+		auto series = "tuxclocker_value{" + label("device", devicePath.mid(1)) + "," +
+			      label("device_name", m_deviceTree.name(devicePath)) + "," +
+			      label("node", path.section('/', -1)) + "," +
+			      label("name", m_deviceTree.name(path));
+		auto unit = m_readables.readable(i).unit();
+		if (unit.has_value())
+			series += "," + label("unit", QString::fromStdString(*unit));
+		m_series.push_back(series + "} ");
+	}
+}
+
+bool MetricsExporter::listenLocal(const QString &path) {
+	QLocalServer::removeServer(path);
+	// Contains nothing that isn't readable on the bus already
+	m_localServer.setSocketOptions(QLocalServer::WorldAccessOption);
+	return m_localServer.listen(path);
+}
+
+bool MetricsExporter::listenTcp(quint16 port) {
+	return m_tcpServer.listen(QHostAddress::LocalHost, port);
+}
+
+void MetricsExporter::render() {
+	m_buffer.clear();
+	m_buffer += header;
+	char number[32];
+	{
+		std::lock_guard<std::mutex> lock{m_seriesMutex};
+		for (size_t i = 0; i < m_series.size(); i++) {
+			// Removed readables have no sample
+			auto sample = m_sampler.peek(i);
+			if (sample.timestamp == 0 || sample.error)
+				continue;
+			m_buffer += m_series[i];
+			auto result = std::to_chars(number, number + sizeof(number), sample.value);
+			m_buffer.append(number, result.ptr);
+			m_buffer += '\n';
+		}
+	}
+	auto statistics = m_sampler.coalescingStatistics();
+	m_buffer += coalescingHeader;
+	m_buffer += "tuxclocker_read_coalescing_total{result=\"hit\"} " +
+		    std::to_string(statistics.hits) + "\n";
+	m_buffer += "tuxclocker_read_coalescing_total{result=\"miss\"} " +
+		    std::to_string(statistics.misses) + "\n";
+	m_buffer += footer;
+
+	std::lock_guard<std::mutex> lock{m_mutex};
+	// Reuses the allocation unless a scrape is still writing the previous body
+	m_body.resize(m_buffer.size());
+	std::memcpy(m_body.data(), m_buffer.data(), m_buffer.size());
+}
+
+template <typename Socket> void MetricsExporter::serve(Socket *socket) {
+	auto request = std::make_shared<QByteArray>();
+	connect(socket, &Socket::disconnected, socket, &QObject::deleteLater);
+	connect(socket, &QIODevice::readyRead, socket, [this, socket, request] {
+		request->append(socket->readAll());
+		if (request->size() > maxRequestSize) {
+			socket->abort();
+			return;
+		}
+		// Any path is answered with the metrics
+		if (!request->contains("\r\n\r\n"))
+			return;
+
+		QByteArray body;
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			body = m_body;
+		}
+		socket->write("HTTP/1.1 200 OK\r\n"
+			      "Content-Type: application/openmetrics-text; version=1.0.0; "
+			      "charset=utf-8\r\n"
+			      "Content-Length: " +
+			      QByteArray::number(body.size()) +
+			      "\r\n"
+			      "Connection: close\r\n\r\n");
+		socket->write(body);
+		// Closes after the response is written
+		if constexpr (std::is_same_v<Socket, QTcpSocket>)
+			socket->disconnectFromHost();
+		else
+			socket->disconnectFromServer();
+	});
+}
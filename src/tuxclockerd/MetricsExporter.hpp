@@ -0,0 +1,50 @@
+#pragma once
+
+#include "DeviceTreeObject.hpp"
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+
+#include <mutex>
+#include <QByteArray>
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <string>
+#include <vector>
+
+/* Serves the latest samples of all DynamicReadables over HTTP in the OpenMetrics text format,
+   eg. for Prometheus, on a unix socket and/or a loopback port. The body is rendered into a
+   reused buffer after every sampler tick, so a scrape only copies it. Series are labeled with
+   the hashes of the device and the node, which stay the same between starts. All
+   DynamicReadables are kept sampled while the exporter exists. */
+class MetricsExporter : public QObject {
+public:
+	MetricsExporter(ReadableTable &readables, Sampler &sampler,
+	    const DeviceTreeObject &deviceTree, QObject *parent = nullptr);
+	// Creates series for readables appended to the table since
+	void addSeries();
+	// Replaces an existing socket file. Returns false if listening fails
+	bool listenLocal(const QString &path);
+	bool listenTcp(quint16 port);
+private:
+	ReadableTable &m_readables;
+	Sampler &m_sampler;
+	const DeviceTreeObject &m_deviceTree;
+	QLocalServer m_localServer;
+	QTcpServer m_tcpServer;
+	// Protects m_series, which grows from the main thread
+	std::mutex m_seriesMutex;
+	// Series name and labels of each readable, eg. 'tuxclocker_value{...} '
+	std::vector<std::string> m_series;
+	// Only used from the sampling thread
+	std::string m_buffer;
+	// Protects m_body
+	std::mutex m_mutex;
+	QByteArray m_body;
+
+	// Sampling thread
+	void render();
+	// Replies to a request on the socket once its headers have arrived
+	template <typename Socket> void serve(Socket *socket);
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <DBusTypes.hpp>
+#include <Device.hpp>
+#include <memory>
+#include <optional>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+using namespace TuxClocker::Device;
+
+namespace TCDBus = TuxClocker::DBus;
+
+// Clock shared by all values read in the daemon, in nanoseconds
+inline qulonglong monotonicTimestamp() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+/* All DynamicReadables of the device tree in preorder, addressable by their DBus path. Indices
+   stay the same when readables are removed, and a readable added again at the same path gets
+   its old index back. Appending within the reserved capacity doesn't move the readables, so
+   other threads can keep reading existing ones. Readables are shared so a read with a deadline
+   can keep one alive after it's removed without copying its read function. */
+class ReadableTable {
+public:
+	/* Limits how many readables and devices there can be from now on. Call before other
+	   threads use the table, which can grow without limit until then */
+	void reserve(int capacity, int deviceCapacity) {
+		m_readables.reserve(capacity);
+		m_devices.reserve(capacity);
+		m_capacity = capacity;
+		m_deviceCapacity = deviceCapacity;
+	}
+	// Index of the readable. Fails if a new readable or device wouldn't fit in the capacity
+	std::optional<int> append(const QString &path, DynamicReadable readable) {
+		auto existing = m_indices.find(path);
+		if (existing != m_indices.end()) {
+			auto index = existing.value();
+			m_readables[index] = std::make_shared<DynamicReadable>(std::move(readable));
+			m_removed[index] = false;
+			return index;
+		}
+		// Top level node, eg. /a7fb for /a7fb/37ca/d0fe
+		auto devicePath = path.section('/', 0, 1);
+		if (!m_deviceIndices.contains(devicePath)) {
+			if (m_deviceCapacity && m_deviceIndices.size() >= *m_deviceCapacity)
+				return std::nullopt;
+			m_deviceIndices.insert(devicePath, m_deviceIndices.size());
+		}
+		if (m_capacity && size() >= *m_capacity)
+			return std::nullopt;
+
+		m_indices.insert(path, m_readables.size());
+		m_paths.append(path);
+		m_devices.push_back(m_deviceIndices.value(devicePath));
+		m_removed.push_back(false);
+		m_readables.push_back(std::make_shared<DynamicReadable>(std::move(readable)));
+		return size() - 1;
+	}
+	// Releases the readable. The Sampler must not sample it anymore
+	void remove(int index) {
+		m_readables[index] = std::make_shared<DynamicReadable>();
+		m_removed[index] = true;
+	}
+	bool removed(int index) const { return m_removed[index]; }
+	std::optional<int> indexOf(const QString &path) const {
+		auto it = m_indices.find(path);
+		if (it == m_indices.end() || m_removed[it.value()])
+			return std::nullopt;
+		return it.value();
+	}
+	// Indices of readables at or below 'path', "/" meaning all of them
+	QVector<int> subtreeIndices(const QString &path) const {
+		QVector<int> retval;
+		auto prefix = path.endsWith('/') ? path : path + '/';
+		for (int i = 0; i < m_paths.size(); i++) {
+			if (!m_removed[i] && (m_paths[i] == path || m_paths[i].startsWith(prefix)))
+				retval.append(i);
+		}
+		return retval;
+	}
+	DynamicReadable &readable(int index) { return *m_readables[index]; }
+	const std::shared_ptr<DynamicReadable> &sharedReadable(int index) const {
+		return m_readables[index];
+	}
+	const QString &path(int index) const { return m_paths[index]; }
+	// Readables of the same device share the device index
+	int device(int index) const { return m_devices[index]; }
+	int deviceCount() const { return m_deviceIndices.size(); }
+	// Including removed readables
+	int size() const { return m_paths.size(); }
+	int capacity() const { return std::max(m_capacity.value_or(0), size()); }
+	int deviceCapacity() const { return std::max(m_deviceCapacity.value_or(0), deviceCount()); }
+private:
+	QVector<QString> m_paths;
+	// Read from the sampling threads
+	std::vector<int> m_devices;
+	std::vector<std::shared_ptr<DynamicReadable>> m_readables;
+	std::vector<bool> m_removed;
+	QHash<QString, int> m_indices;
+	QHash<QString, int> m_deviceIndices;
+	std::optional<int> m_capacity;
+	std::optional<int> m_deviceCapacity;
+};
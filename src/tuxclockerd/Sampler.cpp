@@ -0,0 +1,407 @@
+#include "Sampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Adaptive sampling halves the interval at most once and doubles it at most twice
+constexpr int fastestLevel = -1;
+constexpr int slowestLevel = 2;
+// Unchanged samples in a row before the interval is doubled
+constexpr int flatSamplesBeforeBackoff = 4;
+// Smaller changes relative to the value don't count, eg. jitter of a clock speed
+constexpr double changeThreshold = 0.005;
+
+Sampler::Sampler(ReadableTable &readables, Interval defaultInterval, unsigned int threadCount,
+    bool adaptive)
+    : m_readables(readables), m_defaultInterval(defaultInterval), m_adaptive(adaptive),
+      m_executor(threadCount), m_pool(threadCount) {}
+
+Sampler::~Sampler() {
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_stop = true;
+	}
+	m_condition.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void Sampler::start() {
+	// Room for readables and devices added later
+	auto capacity = m_readables.capacity();
+	m_slots = std::make_unique<SampleSlot[]>(capacity);
+	m_lastAccess = std::make_unique<std::atomic<Clock::rep>[]>(capacity);
+	m_active = std::make_unique<std::atomic<bool>[]>(capacity);
+	m_removed = std::make_unique<std::atomic<bool>[]>(capacity);
+	m_deviceMutexes = std::make_unique<std::mutex[]>(m_readables.deviceCapacity());
+	m_breakers = std::make_unique<CircuitBreaker[]>(capacity);
+	m_stuckDevices = std::shared_ptr<std::atomic<int>[]>(
+	    new std::atomic<int>[m_readables.deviceCapacity()]());
+	m_schedules = std::vector<Schedule>(
+	    m_readables.size(), Schedule{.interval = m_defaultInterval});
+	for (int i = 0; i < m_readables.size(); i++) {
+		m_removed[i] = m_readables.removed(i);
+		resetSchedule(i);
+	}
+	m_epoch = Clock::now();
+
+	m_thread = std::thread{[this] { run(); }};
+}
+
+Sample Sampler::latest(int index) {
+	auto now = Clock::now();
+	m_lastAccess[index].store(now.time_since_epoch().count(), std::memory_order_relaxed);
+
+	if (!m_active[index].load(std::memory_order_acquire)) {
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			activate(index, now);
+		}
+		// Snapshot is either empty or from before the readable was last sampled, which can
+		// still be within the coalescing window
+		return readNow(index);
+	}
+	auto sample = m_slots[index].load(index);
+	if (sample.timestamp == 0)
+		// Activated but not sampled yet
+		return readNow(index);
+	return sample;
+}
+
+Sample Sampler::readNow(int index) {
+	std::lock_guard<std::mutex> lock{m_deviceMutexes[m_readables.device(index)]};
+	// Checked after getting the lock so a read that was in flight counts
+	auto sample = m_slots[index].load(index);
+	auto now = monotonicTimestamp();
+	qulonglong window =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(m_coalescingWindow).count();
+	if (sample.timestamp != 0 && sample.timestamp + window > now) {
+		m_coalescingHits.fetch_add(1, std::memory_order_relaxed);
+		return sample;
+	}
+	m_coalescingMisses.fetch_add(1, std::memory_order_relaxed);
+	sampleDevice({index}, now);
+	return m_slots[index].load(index);
+}
+
+void Sampler::add(int index) {
+	{
+		// Not read after this until it's added
+		std::lock_guard<std::mutex> lock{m_deviceMutexes[m_readables.device(index)]};
+		m_slots[index].store(Sample{});
+		m_breakers[index].reset();
+		m_removed[index] = false;
+	}
+	std::lock_guard<std::mutex> lock{m_mutex};
+	if (index >= m_schedules.size())
+		m_schedules.resize(index + 1, Schedule{.interval = m_defaultInterval});
+	resetSchedule(index);
+	if (!m_schedules[index].pins.empty())
+		// Pinned before it was removed
+		activate(index, Clock::now());
+}
+
+void Sampler::remove(int index) {
+	{
+		// Waits for a read in progress
+		std::lock_guard<std::mutex> lock{m_deviceMutexes[m_readables.device(index)]};
+		m_removed[index] = true;
+		m_slots[index].store(Sample{});
+	}
+	std::lock_guard<std::mutex> lock{m_mutex};
+	m_active[index] = false;
+}
+
+void Sampler::setInterval(int index, Interval interval) {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	auto &schedule = m_schedules[index];
+	schedule.interval = interval;
+	if (m_active[index])
+		schedule.nextDue = nextDue(effectiveInterval(schedule), Clock::now());
+	m_condition.notify_one();
+}
+
+void Sampler::pin(const std::vector<int> &indices, Interval interval) {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	auto now = Clock::now();
+	for (auto index : indices) {
+		auto &schedule = m_schedules[index];
+		schedule.pins[interval.count()]++;
+		if (m_active[index])
+			// May need to be sampled sooner
+			schedule.nextDue = std::min(
+			    schedule.nextDue, nextDue(effectiveInterval(schedule), now));
+		else
+			activate(index, now);
+	}
+	m_condition.notify_one();
+}
+
+void Sampler::unpin(const std::vector<int> &indices, Interval interval) {
+	std::lock_guard<std::mutex> lock{m_mutex};
+	for (auto index : indices) {
+		auto &pins = m_schedules[index].pins;
+		auto it = pins.find(interval.count());
+		if (it != pins.end() && --it->second == 0)
+			pins.erase(it);
+	}
+	// Unpinned readables are deactivated in run() once their lease runs out
+}
+
+void Sampler::run() {
+	std::unique_lock<std::mutex> lock{m_mutex};
+	while (!m_stop) {
+		auto now = Clock::now();
+		auto wakeup = now + std::chrono::seconds(1);
+		std::vector<int> due;
+
+		for (int i = 0; i < m_schedules.size(); i++) {
+			if (!m_active[i])
+				continue;
+
+			auto &schedule = m_schedules[i];
+			auto interval = effectiveInterval(schedule);
+			Clock::time_point lastAccess{Clock::duration{m_lastAccess[i].load()}};
+			auto leaseEnd = lastAccess + leaseLength(schedule.interval);
+			if (schedule.pins.empty() && leaseEnd < now) {
+				m_active[i] = false;
+				continue;
+			}
+			if (schedule.nextDue <= now) {
+				due.push_back(i);
+				schedule.nextDue = nextDue(interval, now);
+			}
+			wakeup = std::min(wakeup, schedule.nextDue);
+		}
+
+		if (due.empty()) {
+			m_condition.wait_until(lock, wakeup);
+			continue;
+		}
+		lock.unlock();
+		auto timestamp = monotonicTimestamp();
+		sample(due, timestamp);
+		for (auto &listener : m_listeners)
+			listener(due, timestamp);
+		lock.lock();
+		if (m_adaptive) {
+			now = Clock::now();
+			for (auto index : due)
+				adapt(index, now);
+		}
+	}
+}
+
+void Sampler::sample(const std::vector<int> &indices, qulonglong timestamp) {
+	std::map<int, std::vector<int>> deviceIndices;
+	for (auto index : indices)
+		deviceIndices[m_readables.device(index)].push_back(index);
+
+	// One task per device since reads of a device are serialized anyway
+	std::vector<std::function<void()>> tasks;
+	for (auto &[device, members] : deviceIndices) {
+		tasks.push_back([this, device = device, members = members, timestamp] {
+			std::lock_guard<std::mutex> lock{m_deviceMutexes[device]};
+			sampleDevice(members, timestamp);
+		});
+	}
+	m_pool.runAll(tasks);
+}
+
+void Sampler::sampleDevice(const std::vector<int> &indices, qulonglong timestamp) {
+	// Asynchronous reads are started first so they overlap with each other and with the
+	// synchronous ones
+	CompletionSet<ReadResult> completions;
+	std::vector<int> started;
+	for (auto index : indices) {
+		// The readable of a removed index may be replaced at any time, so it's checked
+		// before the readable is touched
+		if (m_removed[index])
+			continue;
+		auto &readable = m_readables.readable(index);
+		if (!readable.isAsync() || !startRead(index, timestamp))
+			continue;
+		auto device = m_readables.device(index);
+		auto late = [stuck = m_stuckDevices, device] { stuck[device]--; };
+		readable.readAsync(completions.add(late));
+		started.push_back(index);
+	}
+	// Members of a group are served from one pass of it
+	std::map<ReadableGroup *, std::vector<int>> groups;
+	for (auto index : indices) {
+		if (m_removed[index])
+			continue;
+		auto &readable = m_readables.readable(index);
+		if (readable.isAsync() || !startRead(index, timestamp))
+			continue;
+		if (readable.group())
+			groups[readable.group().get()].push_back(index);
+		else
+			finishRead(index, readSync(index, timestamp), timestamp);
+	}
+	for (auto &[group, members] : groups) {
+		auto device = m_readables.device(members.front());
+		auto pass = readGroup(m_readables.readable(members.front()).group(), device);
+		if (!pass.has_value()) {
+			// One call is stuck for all of them
+			m_stuckDevices[device]++;
+			for (auto index : members)
+				timedOut(index, timestamp);
+			continue;
+		}
+		for (auto index : members) {
+			auto result = ReadableGroup::result(
+			    **pass, m_readables.readable(index).groupIndex());
+			finishRead(index, sampleFromReadResult(result, timestamp), timestamp);
+		}
+	}
+	if (started.empty())
+		return;
+	auto results = completions.wait(m_readDeadline);
+	for (size_t i = 0; i < started.size(); i++) {
+		std::optional<Sample> sample;
+		if (results[i].has_value())
+			sample = sampleFromReadResult(*results[i], timestamp);
+		finishRead(started[i], sample, timestamp);
+	}
+}
+
+bool Sampler::startRead(int index, qulonglong timestamp) {
+	if (m_removed[index])
+		return false;
+	// Device is checked first so a trial read isn't used up without reading
+	if (m_stuckDevices[m_readables.device(index)] > 0 ||
+	    !m_breakers[index].allow(Clock::now())) {
+		m_slots[index].store(sampleFromReadResult(ReadError::UnknownError, timestamp));
+		return false;
+	}
+	return true;
+}
+
+std::optional<Sample> Sampler::readSync(int index, qulonglong timestamp) {
+	auto &readable = m_readables.readable(index);
+	auto &typedReader = readable.typedReader();
+	if (m_readDeadline == Interval::zero())
+		return typedReader.has_value() ? sampleFromTypedReader(*typedReader, timestamp)
+					       : sampleFromReadResult(readable.read(), timestamp);
+
+	auto late = [stuck = m_stuckDevices, device = m_readables.device(index)] {
+		stuck[device]--;
+	};
+	if (typedReader.has_value())
+		return m_executor.run<Sample>(
+		    [reader = *typedReader, timestamp] {
+			    return sampleFromTypedReader(reader, timestamp);
+		    },
+		    m_readDeadline, late);
+	// Shared, since a hung read may return after the readable is removed
+	return m_executor.run<Sample>(
+	    [readable = m_readables.sharedReadable(index), timestamp] {
+		    return sampleFromReadResult(readable->read(), timestamp);
+	    },
+	    m_readDeadline, late);
+}
+
+std::optional<std::shared_ptr<const ReadableGroup::Pass>> Sampler::readGroup(
+    std::shared_ptr<ReadableGroup> group, int device) {
+	if (m_readDeadline == Interval::zero())
+		return group->read();
+	return m_executor.run<std::shared_ptr<const ReadableGroup::Pass>>(
+	    [group] { return group->read(); }, m_readDeadline,
+	    [stuck = m_stuckDevices, device] { stuck[device]--; });
+}
+
+void Sampler::finishRead(int index, std::optional<Sample> sample, qulonglong timestamp) {
+	if (!sample.has_value()) {
+		// Counted, since the late callback can run before this
+		m_stuckDevices[m_readables.device(index)]++;
+		timedOut(index, timestamp);
+		return;
+	}
+	auto &breaker = m_breakers[index];
+	if (sample->error)
+		breaker.failed(Clock::now());
+	else
+		breaker.succeeded();
+	m_slots[index].store(*sample);
+}
+
+void Sampler::timedOut(int index, qulonglong timestamp) {
+	m_breakers[index].timedOut(Clock::now());
+	m_slots[index].store(sampleFromReadResult(ReadError::UnknownError, timestamp));
+}
+
+void Sampler::adapt(int index, Clock::time_point now) {
+	auto &schedule = m_schedules[index];
+	auto sample = m_slots[index].load(index);
+	if (sample.error)
+		return;
+
+	auto previous = schedule.lastValue;
+	schedule.lastValue = sample.value;
+	if (std::isnan(previous))
+		return;
+
+	auto level = schedule.level;
+	auto threshold = changeThreshold * std::max(std::abs(previous), 1.0);
+	if (std::abs(sample.value - previous) > threshold) {
+		// Straight to the fastest rate so the rest of a transient is seen
+		schedule.level = schedule.minLevel;
+		schedule.flatCount = 0;
+	} else if (++schedule.flatCount >= flatSamplesBeforeBackoff) {
+		schedule.level = std::min(schedule.level + 1, schedule.maxLevel);
+		schedule.flatCount = 0;
+	}
+	if (schedule.level != level && schedule.pins.empty())
+		schedule.nextDue = nextDue(effectiveInterval(schedule), now);
+}
+
+Sampler::Interval Sampler::effectiveInterval(const Schedule &schedule) const {
+	Interval interval;
+	if (!schedule.pins.empty())
+		interval = std::min(schedule.interval, Interval{schedule.pins.begin()->first});
+	else if (schedule.level < 0)
+		interval = schedule.interval / (1 << -schedule.level);
+	else
+		interval = schedule.interval * (1 << schedule.level);
+	return std::max({interval, schedule.minimumInterval, shortestInterval});
+}
+
+Sampler::Clock::time_point Sampler::nextDue(Interval interval, Clock::time_point now) const {
+	auto periods = (now - m_epoch) / interval + 1;
+	return m_epoch + periods * interval;
+}
+
+void Sampler::resetSchedule(int index) {
+	auto &hints = m_readables.readable(index).hints();
+	auto &schedule = m_schedules[index];
+	schedule.minimumInterval = hints.minimumInterval;
+	schedule.level = 0;
+	schedule.flatCount = 0;
+	schedule.lastValue = std::numeric_limits<double>::quiet_NaN();
+	if (!m_adaptive)
+		return;
+	// Sampling faster doesn't find more in values that are always changing, and backing off
+	// would miss when they jump from being idle
+	schedule.minLevel =
+	    (hints.cost == ReadCost::Expensive || hints.volatility == Volatility::High)
+		? 0
+		: fastestLevel;
+	schedule.maxLevel = (hints.volatility == Volatility::High) ? 0 : slowestLevel;
+	if (hints.volatility == Volatility::Low)
+		schedule.level = schedule.maxLevel;
+}
+
+void Sampler::activate(int index, Clock::time_point now) {
+	if (m_active[index] || m_removed[index])
+		return;
+	m_schedules[index].nextDue = nextDue(effectiveInterval(m_schedules[index]), now);
+	m_active[index] = true;
+	m_condition.notify_one();
+}
+
+Sampler::Clock::duration Sampler::leaseLength(Interval interval) const {
+	// Clients polling at a slower rate than the interval keep the readable sampled too
+	return std::max<Clock::duration>(10 * interval, std::chrono::seconds(10));
+}
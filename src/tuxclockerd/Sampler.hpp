@@ -0,0 +1,310 @@
+#pragma once
+
+#include "CircuitBreaker.hpp"
+#include "CompletionSet.hpp"
+#include "DeadlineExecutor.hpp"
+#include "ReadableTable.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <patterns.hpp>
+#include <QVariant>
+#include <SampleRecord.hpp>
+#include <thread>
+#include <vector>
+
+using namespace mpark::patterns;
+
+using TuxClocker::SampleType;
+// Timestamps in nanoseconds, see monotonicTimestamp()
+using Sample = TuxClocker::SampleRecord;
+
+// Index and sequence are filled in by the Sampler
+inline Sample sampleFromReadResult(const ReadResult &result, qulonglong timestamp) {
+	Sample sample{.timestamp = timestamp,
+	    .error = true,
+	    .type = SampleType::Int,
+	    .value = static_cast<double>(ReadError::UnknownError)};
+	match(result)(
+	    pattern(as<ReadableValue>(arg)) =
+		[&](const auto &val) {
+			match(val)(
+			    pattern(as<int>(arg)) =
+				[&](auto i) {
+					sample.error = false;
+					sample.value = i;
+				},
+			    pattern(as<uint>(arg)) =
+				[&](auto u) {
+					sample.error = false;
+					sample.type = SampleType::UInt;
+					sample.value = u;
+				},
+			    pattern(as<double>(arg)) =
+				[&](auto d) {
+					sample.error = false;
+					sample.type = SampleType::Double;
+					sample.value = d;
+				},
+			    // Strings can't be sampled
+			    pattern(_) = [] {});
+		},
+	    pattern(as<ReadError>(arg)) =
+		[&](auto err) { sample.value = static_cast<double>(err); });
+	return sample;
+}
+
+// Without a ReadResult in between
+inline Sample sampleFromTypedReader(const TypedReadFunc &reader, qulonglong timestamp) {
+	return std::visit(
+	    [&](auto &typedReader) {
+		    typename std::decay_t<decltype(typedReader)>::Value value;
+		    if (!typedReader.read(value))
+			    return Sample{.timestamp = timestamp,
+				.error = true,
+				.type = SampleType::Int,
+				.value = static_cast<double>(ReadError::UnknownError)};
+		    // Same order in the variant
+		    return Sample{.timestamp = timestamp,
+			.error = false,
+			.type = static_cast<SampleType>(reader.index()),
+			.value = static_cast<double>(value)};
+	    },
+	    reader);
+}
+
+inline TCDBus::BatchValue toBatchValue(const Sample &sample) {
+	return {sample.error != 0, static_cast<uchar>(sample.type), sample.value};
+}
+
+inline TCDBus::TimedValue toTimedValue(const Sample &sample) {
+	return {sample.timestamp, sample.sequence, sample.error != 0,
+	    static_cast<uchar>(sample.type), sample.value};
+}
+
+// Value with the type it was read as, or the error code
+inline QVariant toVariant(const Sample &sample) {
+	if (sample.error)
+		return static_cast<int>(sample.value);
+	switch (sample.type) {
+	case SampleType::Int:
+		return static_cast<int>(sample.value);
+	case SampleType::UInt:
+		return static_cast<uint>(sample.value);
+	case SampleType::Double:
+		return sample.value;
+	}
+	return QVariant{};
+}
+
+// Latest Sample of a readable. One writer at a time, readers never block the writer (seqlock)
+class SampleSlot {
+public:
+	void store(const Sample &sample) {
+		auto seq = m_sequence.load(std::memory_order_relaxed);
+		// Odd sequence means a write is in progress
+		m_sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		uint64_t bits;
+		std::memcpy(&bits, &sample.value, sizeof(bits));
+		m_timestamp.store(sample.timestamp, std::memory_order_relaxed);
+		m_error.store(sample.error != 0, std::memory_order_relaxed);
+		m_type.store(sample.type, std::memory_order_relaxed);
+		m_valueBits.store(bits, std::memory_order_relaxed);
+
+		m_sequence.store(seq + 2, std::memory_order_release);
+	}
+	// Slots don't know their index, it's copied into the sample
+	Sample load(uint32_t index) const {
+		while (true) {
+			auto before = m_sequence.load(std::memory_order_acquire);
+			if (before & 1)
+				continue;
+
+			Sample sample{
+			    .index = index, .sequence = static_cast<uint32_t>(before / 2)};
+			auto bits = m_valueBits.load(std::memory_order_relaxed);
+			sample.timestamp = m_timestamp.load(std::memory_order_relaxed);
+			sample.error = m_error.load(std::memory_order_relaxed);
+			sample.type = m_type.load(std::memory_order_relaxed);
+			std::memcpy(&sample.value, &bits, sizeof(bits));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_sequence.load(std::memory_order_relaxed) == before)
+				return sample;
+		}
+	}
+private:
+	// Twice the number of stores, doubles as the sequence of the samples
+	std::atomic<uint64_t> m_sequence{0};
+	std::atomic<uint64_t> m_timestamp{0};
+	std::atomic<bool> m_error{false};
+	std::atomic<SampleType> m_type{SampleType::Int};
+	std::atomic<uint64_t> m_valueBits{0};
+};
+
+/* Reads DynamicReadables periodically from worker threads and keeps the latest values in a
+   snapshot, so serving a value doesn't need to touch the hardware. Readables are sampled
+   while they're being accessed (see latest()) or pinned. Readables due at the same time are
+   sampled in the same tick and share the timestamp.
+
+   Intervals are never shorter than the minimum interval of the readable's SamplingHints, nor
+   than shortestInterval. Intervals clients ask for are raised to the client minimum. When
+   adaptive, readables that aren't pinned are sampled up to twice as often while their value
+   changes and back off to a quarter of the rate while it stays the same. Pinned readables are
+   always sampled at the pinned rate, so subscribers get what they asked for.
+
+   With a read deadline, reads that take longer are given up on and count as errors. Each
+   readable has a CircuitBreaker that stops reading it while it keeps failing, and other
+   readables of a device with a hung read aren't read until that read returns. Asynchronous
+   DynamicReadables of a device are started together and waited for with one deadline. */
+class Sampler {
+public:
+	using Clock = std::chrono::steady_clock;
+	using Interval = std::chrono::milliseconds;
+	// Called from the sampling thread after a tick with the readables sampled in it
+	using Listener = std::function<void(const std::vector<int> &indices, qulonglong timestamp)>;
+	struct CoalescingStatistics {
+		// Direct reads answered with a sample from within the coalescing window
+		qulonglong hits;
+		// Direct reads that read the readable
+		qulonglong misses;
+	};
+
+	// No readable is sampled more often, whatever is asked for
+	static constexpr Interval shortestInterval{10};
+
+	Sampler(ReadableTable &readables, Interval defaultInterval, unsigned int threadCount,
+	    bool adaptive = true);
+	~Sampler();
+	// Allocates room for as many readables and devices as the table has capacity for
+	void start();
+	// Starts keeping track of a readable appended to the table or added again after start().
+	// Pins made before it was removed still apply
+	void add(int index);
+	// Stops sampling a readable before it's removed from the table, waiting for a read of it
+	// in progress. Its sample is cleared
+	void remove(int index);
+	// Latest sample of a readable, read directly if there isn't one yet
+	Sample latest(int index);
+	/* Reads directly, unless the readable was sampled within the coalescing window. Callers
+	   waiting for a read of the same device share the result if it's of the same readable. */
+	Sample readNow(int index);
+	// Zero reads every time. Call before start()
+	void setCoalescingWindow(Interval window) { m_coalescingWindow = window; }
+	// Zero reads without a deadline. Call before start()
+	void setReadDeadline(Interval deadline) { m_readDeadline = deadline; }
+	Interval readDeadline() const { return m_readDeadline; }
+	CircuitBreaker::Status breakerStatus(int index) const { return m_breakers[index].status(); }
+	CoalescingStatistics coalescingStatistics() const {
+		return {m_coalescingHits.load(std::memory_order_relaxed),
+		    m_coalescingMisses.load(std::memory_order_relaxed)};
+	}
+	// Latest sample without counting as an access. Timestamp is zero if never sampled
+	Sample peek(int index) const { return m_slots[index].load(index); }
+	// Listeners need to be added before start()
+	void addListener(Listener listener) { m_listeners.push_back(std::move(listener)); }
+	// Interval used for a readable unless a pin wants it faster
+	void setInterval(int index, Interval interval);
+	// Keeps readables sampled at least at 'interval' until unpinned
+	void pin(const std::vector<int> &indices, Interval interval);
+	void unpin(const std::vector<int> &indices, Interval interval);
+	Interval defaultInterval() const { return m_defaultInterval; }
+	// Intervals apply to all clients, so one can't make every readable it can see sampled
+	// faster than this. Call before start()
+	void setClientMinimum(Interval minimum) { m_clientMinimum = minimum; }
+	// Interval for 'milliseconds' asked for by a client, zero meaning the default interval
+	Interval clientInterval(uint milliseconds) const {
+		if (milliseconds == 0)
+			return m_defaultInterval;
+		return std::max(Interval{milliseconds}, m_clientMinimum);
+	}
+private:
+	struct Schedule {
+		Interval interval;
+		// Intervals requested by pins, with their counts
+		std::map<Interval::rep, int> pins;
+		Clock::time_point nextDue;
+		// From the readable's SamplingHints
+		Interval minimumInterval;
+		// Interval of unpinned readables is scaled by 2^level, between the limits
+		int level;
+		int minLevel;
+		int maxLevel;
+		// Samples in a row with the same value
+		int flatCount;
+		// NaN until sampled in a tick
+		double lastValue;
+	};
+
+	ReadableTable &m_readables;
+	Interval m_defaultInterval;
+	Interval m_clientMinimum{shortestInterval};
+	bool m_adaptive;
+	Interval m_coalescingWindow{0};
+	std::atomic<qulonglong> m_coalescingHits{0};
+	std::atomic<qulonglong> m_coalescingMisses{0};
+	Interval m_readDeadline{0};
+	// Used from the workers of m_pool, so it needs to outlive them
+	DeadlineExecutor m_executor;
+	ThreadPool m_pool;
+	Clock::time_point m_epoch;
+	std::vector<Listener> m_listeners;
+
+	std::unique_ptr<SampleSlot[]> m_slots;
+	// Last time latest() was called, in clock ticks
+	std::unique_ptr<std::atomic<Clock::rep>[]> m_lastAccess;
+	// If the readable is currently sampled
+	std::unique_ptr<std::atomic<bool>[]> m_active;
+	// Removed readables aren't read, checked with the device mutex held
+	std::unique_ptr<std::atomic<bool>[]> m_removed;
+	// Reads of the same device are serialized
+	std::unique_ptr<std::mutex[]> m_deviceMutexes;
+	// Checked with the device mutex held
+	std::unique_ptr<CircuitBreaker[]> m_breakers;
+	// Reads given up on per device that haven't returned yet. Shared with the late callbacks
+	std::shared_ptr<std::atomic<int>[]> m_stuckDevices;
+
+	// Protects the members below
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<Schedule> m_schedules;
+	bool m_stop = false;
+	std::thread m_thread;
+
+	void run();
+	void sample(const std::vector<int> &indices, qulonglong timestamp);
+	// Readables of one device. Device mutex needs to be held for this and the ones below
+	void sampleDevice(const std::vector<int> &indices, qulonglong timestamp);
+	// Stores an error sample instead if the readable shouldn't be read now
+	bool startRead(int index, qulonglong timestamp);
+	// Nothing if the read was given up on
+	std::optional<Sample> readSync(int index, qulonglong timestamp);
+	// Nothing if the pass was given up on. 'device' is the one of the members
+	std::optional<std::shared_ptr<const ReadableGroup::Pass>> readGroup(
+	    std::shared_ptr<ReadableGroup> group, int device);
+	void finishRead(int index, std::optional<Sample> sample, qulonglong timestamp);
+	// Doesn't count the stuck call
+	void timedOut(int index, qulonglong timestamp);
+	// Adjusts the level of a readable sampled in the last tick. m_mutex needs to be held
+	void adapt(int index, Clock::time_point now);
+	Interval effectiveInterval(const Schedule &schedule) const;
+	// Earliest multiple of the interval after 'now', so equal intervals line up
+	Clock::time_point nextDue(Interval interval, Clock::time_point now) const;
+	// Schedule from the readable's hints, keeping the interval and pins. m_mutex needs to be
+	// held
+	void resetSchedule(int index);
+	// m_mutex needs to be held
+	void activate(int index, Clock::time_point now);
+	// How long a readable stays sampled after being accessed
+	Clock::duration leaseLength(Interval interval) const;
+};
@@ -0,0 +1,107 @@
+#include "Subscriptions.hpp"
+
+#include <QDBusMessage>
+#include <QMetaObject>
+
+// Ticks may come a bit early relative to the previous emission since sampling takes time
+constexpr int intervalSlackDivisor = 10;
+
+bool changed(const Sample &previous, const Sample &current) {
+	return previous.timestamp == 0 || previous.error != current.error ||
+	       previous.type != current.type || previous.value != current.value;
+}
+
+Subscriptions::Subscriptions(
+    QDBusConnection connection, ReadableTable &readables, Sampler &sampler, QObject *parent)
+    : QObject(parent), m_connection(connection), m_readables(readables), m_sampler(sampler),
+      m_watcher(QString{}, connection, QDBusServiceWatcher::WatchForUnregistration) {
+	// Clean up after clients that disconnect without unsubscribing
+	connect(&m_watcher, &QDBusServiceWatcher::serviceUnregistered, this,
+	    [this](const QString &client) { removeClient(client); });
+
+	m_sampler.addListener([this](const std::vector<int> &, qulonglong timestamp) {
+		QMetaObject::invokeMethod(
+		    this, [this, timestamp] { onTick(timestamp); }, Qt::QueuedConnection);
+	});
+}
+
+uint Subscriptions::subscribe(
+    const QString &client, const QStringList &paths, Sampler::Interval interval) {
+	Subscription subscription{.client = client, .interval = interval};
+	for (auto &path : paths) {
+		auto index = m_readables.indexOf(path);
+		if (index.has_value())
+			subscription.indices.push_back(*index);
+	}
+	if (subscription.indices.empty())
+		return 0;
+
+	subscription.sent = std::vector<Sample>(subscription.indices.size(), Sample{});
+	m_sampler.pin(subscription.indices, interval);
+	m_watcher.addWatchedService(client);
+
+	auto id = m_nextId++;
+	m_subscriptions.emplace(id, std::move(subscription));
+	return id;
+}
+
+bool Subscriptions::unsubscribe(const QString &client, uint id) {
+	auto it = m_subscriptions.find(id);
+	if (it == m_subscriptions.end() || it->second.client != client)
+		return false;
+	remove(it);
+	return true;
+}
+
+void Subscriptions::onTick(qulonglong timestamp) {
+	for (auto &[id, subscription] : m_subscriptions) {
+		auto interval =
+		    std::chrono::duration_cast<std::chrono::nanoseconds>(subscription.interval)
+			.count();
+		if (subscription.emitted != 0 &&
+		    timestamp < subscription.emitted + interval - interval / intervalSlackDivisor)
+			continue;
+
+		TCDBus::ValueBatch batch{.timestamp = timestamp};
+		for (size_t i = 0; i < subscription.indices.size(); i++) {
+			auto index = subscription.indices[i];
+			auto sample = m_sampler.peek(index);
+			if (sample.timestamp == 0 || !changed(subscription.sent[i], sample))
+				continue;
+			subscription.sent[i] = sample;
+			batch.paths.append(m_readables.path(index));
+			batch.values.append(toBatchValue(sample));
+		}
+		subscription.emitted = timestamp;
+		if (batch.paths.empty())
+			continue;
+
+		auto signal = QDBusMessage::createTargetedSignal(
+		    subscription.client, "/", "org.tuxclocker", "valuesChanged");
+		signal << id << QVariant::fromValue(batch);
+		m_connection.send(signal);
+	}
+}
+
+void Subscriptions::remove(std::map<uint, Subscription>::iterator it) {
+	m_sampler.unpin(it->second.indices, it->second.interval);
+	auto client = it->second.client;
+	m_subscriptions.erase(it);
+
+	for (auto &[id, subscription] : m_subscriptions) {
+		if (subscription.client == client)
+			return;
+	}
+	m_watcher.removeWatchedService(client);
+}
+
+void Subscriptions::removeClient(const QString &client) {
+	for (auto it = m_subscriptions.begin(); it != m_subscriptions.end();) {
+		if (it->second.client == client) {
+			m_sampler.unpin(it->second.indices, it->second.interval);
+			it = m_subscriptions.erase(it);
+		} else
+			++it;
+	}
+	m_watcher.removeWatchedService(client);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+
+#include <map>
+#include <QDBusConnection>
+#include <QDBusServiceWatcher>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+Q_DECLARE_METATYPE(TCDBus::BatchValue)
+Q_DECLARE_METATYPE(TCDBus::ValueBatch)
+
+/* Clients subscribed to sets of DynamicReadables. After each sampling tick, subscriptions
+   whose interval has passed get the values that changed since their previous emission as a
+   'valuesChanged' signal sent only to the subscriber. */
+class Subscriptions : public QObject {
+public:
+	Subscriptions(QDBusConnection connection, ReadableTable &readables, Sampler &sampler,
+	    QObject *parent = nullptr);
+	// Returns the id of the subscription, or zero if none of the paths exist
+	uint subscribe(const QString &client, const QStringList &paths, Sampler::Interval interval);
+	// Only the client that subscribed can unsubscribe
+	bool unsubscribe(const QString &client, uint id);
+private:
+	struct Subscription {
+		// Unique bus name of the subscriber
+		QString client;
+		std::vector<int> indices;
+		Sampler::Interval interval;
+		// Timestamp of the previous emission, zero before the first one
+		qulonglong emitted = 0;
+		// Values in the previous emission. All values are sent the first time
+		std::vector<Sample> sent;
+	};
+
+	QDBusConnection m_connection;
+	ReadableTable &m_readables;
+	Sampler &m_sampler;
+	QDBusServiceWatcher m_watcher;
+	std::map<uint, Subscription> m_subscriptions;
+	uint m_nextId = 1;
+
+	// Main thread
+	void onTick(qulonglong timestamp);
+	void remove(std::map<uint, Subscription>::iterator it);
+	void removeClient(const QString &client);
+};
@@ -0,0 +1,83 @@
+#include "Telemetry.hpp"
+
+#include <grp.h>
+#include <pwd.h>
+#include <QDBusConnectionInterface>
+#include <QDebug>
+#include <unistd.h>
+#include <vector>
+
+using namespace TuxClocker::Telemetry;
+
+Telemetry::Telemetry(QDBusConnection connection, ReadableTable &readables, Sampler &sampler,
+    uint capacity, QString group, QObject *parent)
+    : QObject(parent), m_connection(connection), m_sampler(sampler), m_group(group) {
+	if (capacity == 0)
+		return;
+
+	std::vector<std::string> paths;
+	for (int i = 0; i < readables.size(); i++)
+		paths.push_back(readables.path(i).toStdString());
+	m_pathCount = paths.size();
+	m_ring = RingWriter::create(paths, capacity);
+	if (!m_ring.has_value()) {
+		qWarning() << "Couldn't create telemetry ring";
+		return;
+	}
+
+	m_sampler.addListener([this](const std::vector<int> &indices, qulonglong) {
+		for (auto index : indices) {
+			// Readables added after start aren't in the ring's path list
+			if (index >= m_pathCount)
+				continue;
+			m_ring->write(m_sampler.peek(index));
+		}
+	});
+}
+
+QDBusUnixFileDescriptor Telemetry::open(const QDBusMessage &message) {
+	auto replyError = [&](QDBusError::ErrorType type, const QString &text) {
+		message.setDelayedReply(true);
+		m_connection.send(message.createErrorReply(type, text));
+		return QDBusUnixFileDescriptor{};
+	};
+	if (!m_ring.has_value())
+		return replyError(QDBusError::NotSupported, "Telemetry ring is disabled");
+	if (!authorized(message.service()))
+		return replyError(QDBusError::AccessDenied, "Not allowed to open telemetry ring");
+
+	auto fd = m_ring->readOnlyFd();
+	if (!fd.has_value())
+		return replyError(QDBusError::Failed, "Couldn't open telemetry ring");
+	QDBusUnixFileDescriptor retval;
+	retval.giveFileDescriptor(*fd);
+	return retval;
+}
+
+bool Telemetry::authorized(const QString &client) {
+	if (m_group.isEmpty())
+		return true;
+
+	auto uidReply = m_connection.interface()->serviceUid(client);
+	if (!uidReply.isValid())
+		return false;
+	uid_t uid = uidReply.value();
+	if (uid == 0)
+		return true;
+
+	auto group = getgrnam(m_group.toUtf8().constData());
+	auto passwd = getpwuid(uid);
+	if (!group || !passwd)
+		return false;
+	auto gid = group->gr_gid;
+
+	int count = 0;
+	getgrouplist(passwd->pw_name, passwd->pw_gid, nullptr, &count);
+	std::vector<gid_t> groups(count);
+	getgrouplist(passwd->pw_name, passwd->pw_gid, groups.data(), &count);
+	for (auto g : groups) {
+		if (g == gid)
+			return true;
+	}
+	return false;
+}
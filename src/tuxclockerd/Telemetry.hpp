@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ReadableTable.hpp"
+#include "Sampler.hpp"
+
+#include <optional>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusUnixFileDescriptor>
+#include <QObject>
+#include <QString>
+#include <TelemetryRing.hpp>
+
+/* Writes every sample taken by the Sampler into a shared memory ring, and hands out read-only
+   descriptors of it to clients. If 'group' isn't empty, only root and members of the group
+   may open the ring. */
+class Telemetry : public QObject {
+public:
+	Telemetry(QDBusConnection connection, ReadableTable &readables, Sampler &sampler,
+	    uint capacity, QString group, QObject *parent = nullptr);
+	// Replies with an error to 'message' if the ring can't be opened by the caller
+	QDBusUnixFileDescriptor open(const QDBusMessage &message);
+private:
+	QDBusConnection m_connection;
+	Sampler &m_sampler;
+	QString m_group;
+	// Written from the sampling thread only
+	std::optional<TuxClocker::Telemetry::RingWriter> m_ring;
+	int m_pathCount = 0;
+
+	bool authorized(const QString &client);
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed amount of threads running queued tasks in FIFO order
+class ThreadPool {
+public:
+	explicit ThreadPool(unsigned int threadCount) {
+		for (unsigned int i = 0; i < std::max(threadCount, 1u); i++)
+			m_threads.emplace_back([this] { run(); });
+	}
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_stop = true;
+		}
+		m_condition.notify_all();
+		for (auto &thread : m_threads)
+			thread.join();
+	}
+	void push(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_tasks.push_back(std::move(task));
+		}
+		m_condition.notify_one();
+	}
+	// Runs 'tasks' and waits for all of them to finish
+	void runAll(std::vector<std::function<void()>> tasks) {
+		std::mutex mutex;
+		std::condition_variable done;
+		auto remaining = tasks.size();
+
+		for (auto &task : tasks) {
+			push([&, task = std::move(task)] {
+				task();
+				std::lock_guard<std::mutex> lock{mutex};
+				if (--remaining == 0)
+					done.notify_one();
+			});
+		}
+		std::unique_lock<std::mutex> lock{mutex};
+		done.wait(lock, [&] { return remaining == 0; });
+	}
+	unsigned int threadCount() const { return m_threads.size(); }
+private:
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stop = false;
+
+	void run() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock{m_mutex};
+				m_condition.wait(
+				    lock, [this] { return m_stop || !m_tasks.empty(); });
+				if (m_stop && m_tasks.empty())
+					return;
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
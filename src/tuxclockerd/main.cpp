@@ -1,6 +1,13 @@
+#include <boost/dll/runtime_symbol_info.hpp>
+#include <chrono>
 #include <DBusTypes.hpp>
+#include <filesystem>
+#include <future>
 #include <iostream>
 #include <libintl.h>
+#include <malloc.h>
+#include <numeric>
+#include <optional>
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QDBusConnection>
@@ -9,9 +16,15 @@
 #include <QDebug>
 #include <patterns.hpp>
 #include <Plugin.hpp>
+#include <ProbeCache.hpp>
+#include <thread>
 #include <Tree.hpp>
 
-#include "AdaptorFactory.hpp"
+#include "Adaptors.hpp"
+#include "DeviceRegistry.hpp"
+#include "DeviceTreeObject.hpp"
+#include "History.hpp"
+#include "MetricsExporter.hpp"
 
 using namespace TuxClocker;
 using namespace TuxClocker::Device;
@@ -20,83 +33,253 @@ using namespace mpark::patterns;
 
 namespace TCDBus = TuxClocker::DBus;
 
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+// Devices that can appear after start besides the ones already seen
+constexpr int hotplugDevices = 64;
+
+Milliseconds elapsedSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::steady_clock::now() - start;
+}
+
+// Bytes allocated from the heap, zero if unknown. Signed, since the heap can also shrink
+// between two calls
+long long heapInUse() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+	auto info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+#else
+	return 0;
+#endif
+}
+
+// Milliseconds of an interval option, if it's a number the Sampler allows
+std::optional<Sampler::Interval> parseInterval(const QString &value) {
+	bool ok;
+	Sampler::Interval interval{value.toUInt(&ok)};
+	if (!ok || interval < Sampler::shortestInterval)
+		return std::nullopt;
+	return interval;
+}
+
 int main(int argc, char **argv) {
 	QCoreApplication a(argc, argv);
 	a.setApplicationVersion(TUXCLOCKER_VERSION_STRING);
 
 	QCommandLineParser parser;
 	parser.addVersionOption();
+	QCommandLineOption intervalOption{"sampling-interval",
+	    "Default interval for sampling readables in milliseconds.", "milliseconds", "1000"};
+	QCommandLineOption clientMinimumOption{"client-minimum-interval",
+	    "Shortest sampling interval clients can ask for in milliseconds.", "milliseconds",
+	    "100"};
+	QCommandLineOption threadsOption{"sampling-threads",
+	    "Amount of threads used for sampling readables.", "threads",
+	    QString::number(std::max(std::thread::hardware_concurrency(), 1u))};
+	QCommandLineOption ringSizeOption{"telemetry-ring-size",
+	    "Amount of samples kept in the shared memory telemetry ring. 0 disables the ring.",
+	    "samples", "65536"};
+	QCommandLineOption ringGroupOption{"telemetry-group",
+	    "Only allow root and members of this group to open the telemetry ring.", "group"};
+	parser.addOption(intervalOption);
+	parser.addOption(clientMinimumOption);
+	parser.addOption(threadsOption);
+	parser.addOption(ringSizeOption);
+	QCommandLineOption probeCacheOption{"probe-cache",
+	    "File for remembering which device nodes exist between starts. Empty disables the "
+	    "cache.",
+	    "path", "/var/cache/tuxclocker/probe-cache"};
+	QCommandLineOption sessionBusOption{"session-bus",
+	    "Register on the session bus instead of the system bus, eg. for benchmarks."};
+	QCommandLineOption historyOption{"history-tiers",
+	    "Resolutions and lengths of the history kept of sampled readables, as comma separated "
+	    "<seconds>:<entries> pairs. Empty disables history.",
+	    "tiers", "1:300,60:240,3600:168"};
+	QCommandLineOption sampleAllOption{"sample-all",
+	    "Sample all readables at the default interval, so there's history of all of them."};
+	QCommandLineOption fixedSamplingOption{"fixed-sampling",
+	    "Sample readables at their interval even when their values don't change."};
+	QCommandLineOption hotplugOption{"hotplug-readables",
+	    "Amount of new DynamicReadables that can be added by devices appearing after start.",
+	    "count", "4096"};
+	QCommandLineOption coalescingOption{"coalescing-window",
+	    "Serve reads of readables that aren't being sampled with a sample taken at most this "
+	    "many milliseconds ago. 0 reads every time.",
+	    "milliseconds", "50"};
+	QCommandLineOption readDeadlineOption{"read-deadline",
+	    "Give up on reads of readables and current values of assignables that take longer than "
+	    "this many milliseconds, and back off from reading nodes that keep failing. 0 waits "
+	    "for every read.",
+	    "milliseconds", "1000"};
+	parser.addOption(ringGroupOption);
+	parser.addOption(probeCacheOption);
+	parser.addOption(sessionBusOption);
+	QCommandLineOption metricsSocketOption{"metrics-socket",
+	    "Serve OpenMetrics over HTTP on this unix socket. Samples all readables.", "path"};
+	QCommandLineOption metricsPortOption{"metrics-port",
+	    "Serve OpenMetrics over HTTP on this port of the loopback interface. Samples all "
+	    "readables.",
+	    "port"};
+	parser.addOption(historyOption);
+	parser.addOption(sampleAllOption);
+	parser.addOption(fixedSamplingOption);
+	parser.addOption(coalescingOption);
+	parser.addOption(readDeadlineOption);
+	parser.addOption(hotplugOption);
+	parser.addOption(metricsSocketOption);
+	parser.addOption(metricsPortOption);
 	parser.process(a);
 
+	auto interval = parseInterval(parser.value(intervalOption));
+	if (!interval.has_value()) {
+		qWarning() << "invalid sampling interval:" << parser.value(intervalOption)
+			   << "(at least" << Sampler::shortestInterval.count() << "ms)";
+		return 1;
+	}
+	auto clientMinimum = parseInterval(parser.value(clientMinimumOption));
+	if (!clientMinimum.has_value()) {
+		qWarning() << "invalid client minimum interval:"
+			   << parser.value(clientMinimumOption) << "(at least"
+			   << Sampler::shortestInterval.count() << "ms)";
+		return 1;
+	}
+	bool portOk = true;
+	auto metricsPort = parser.value(metricsPortOption).toUShort(&portOk);
+	if (parser.isSet(metricsPortOption) && (!portOk || metricsPort == 0)) {
+		qWarning() << "invalid metrics port:" << parser.value(metricsPortOption);
+		return 1;
+	}
+	auto historyTiers = History::parseTiers(parser.value(historyOption));
+	if (!historyTiers.has_value()) {
+		qWarning() << "invalid history tiers:" << parser.value(historyOption);
+		return 1;
+	}
+
 	// TODO: should numbers here be localized or not?
 	setlocale(LC_MESSAGES, "");
 	bindtextdomain("tuxclocker", TUXCLOCKER_LOCALE_PATH);
 	bind_textdomain_codeset("tuxclocker", "UTF-8");
 	textdomain("tuxclocker");
 
-	auto connection = QDBusConnection::systemBus();
+	auto startupStart = std::chrono::steady_clock::now();
+	auto probeCachePath = parser.value(probeCacheOption).toStdString();
+	// Cache is invalidated by hardware changes and by updating TuxClocker itself, since plugins
+	// may create different nodes
+	if (!probeCachePath.empty())
+		// Files recorded under TUXCLOCKER_FS_ROOT aren't the fingerprinted hardware
+		ProbeCache::load(probeCachePath,
+		    ProbeCache::hardwareFingerprint() + " " + TUXCLOCKER_VERSION_STRING + " " +
+			qEnvironmentVariable("TUXCLOCKER_FS_ROOT").toStdString());
+	auto connection = parser.isSet(sessionBusOption) ? QDBusConnection::sessionBus()
+							 : QDBusConnection::systemBus();
 	auto plugins = DevicePlugin::loadPlugins();
-	QVector<QDBusAbstractAdaptor *> adaptors;
 	QObject root;
-	TreeNode<TCDBus::DeviceNode> dbusRootNode;
-
-	std::function<void(TreeNode<DeviceNode>, QString, TreeNode<TCDBus::DeviceNode> *)> traverse;
-	traverse = [&traverse, &connection, &adaptors, &root](TreeNode<DeviceNode> node,
-		       QString parentPath, TreeNode<TCDBus::DeviceNode> *dbusNode) {
-		auto obj = new QObject(&root); // Is destroyed when root goes out of scope
-		auto objName = QString::fromStdString(node.value().hash).replace(" ", "");
-		auto thisPath = parentPath + objName;
-		QString ifaceName;
-		adaptors.append(new NodeAdaptor(obj, node.value()));
-		if_let(pattern(some(arg)) = node.value().interface) = [&](auto iface) {
-			if_let(pattern(some(arg)) =
-				   AdaptorFactory::adaptor(obj, iface)) = [&](auto adaptor) {
-				adaptors.append(adaptor);
-				// TODO: don't hardcode interface name
-				// Maybe create an intermediate class that contains the interface
-				// name to avoid this For some reason this throws a bad_cast when
-				// using 'as' with pointer type
-				match (*adaptor)(
-				    pattern(as<AssignableAdaptor>(_)) =
-					[&] { ifaceName = "org.tuxclocker.Assignable"; },
-				    pattern(as<DynamicReadableAdaptor>(_)) =
-					[&] { ifaceName = "org.tuxclocker.DynamicReadable"; },
-				    pattern(as<StaticReadableAdaptor>(_)) =
-					[&] { ifaceName = "org.tuxclocker.StaticReadable"; },
-				    pattern(_) = [] {});
-			};
-		};
-		if (!connection.registerObject(thisPath, obj))
-			qDebug() << "Couldn't register object at path" << thisPath
-				 << connection.lastError();
-
-		auto thisDBusNode = TreeNode<TCDBus::DeviceNode>{{ifaceName, thisPath}};
-		dbusNode->appendChild(thisDBusNode);
-		qDebug() << thisPath;
-		for (const auto &child : node.children())
-			traverse(child, thisPath + "/", &dbusNode->childrenPtr()->back());
-	};
-
-	TreeNode<DeviceNode> lvl1nodes;
+	ReadableTable readables;
+	Sampler sampler{readables, *interval, parser.value(threadsOption).toUInt(),
+	    !parser.isSet(fixedSamplingOption)};
+	sampler.setClientMinimum(*clientMinimum);
+	sampler.setCoalescingWindow(Sampler::Interval{parser.value(coalescingOption).toUInt()});
+	sampler.setReadDeadline(Sampler::Interval{parser.value(readDeadlineOption).toUInt()});
+
+	// Serves every device node, registered at the path of each top level node
+	auto deviceTree = new DeviceTreeObject(sampler, &root);
+	auto registry = new DeviceRegistry(connection, readables, sampler, *deviceTree, &root);
+
+	std::vector<TreeNode<DeviceNode>> pluginRoots;
 	if (plugins.has_value()) {
+		// Plugins probe their devices independently of each other, so build the trees
+		// concurrently. They're still registered in plugin order to keep the order stable
+		std::vector<std::future<std::pair<TreeNode<DeviceNode>, Milliseconds>>> trees;
 		for (auto &plugin : plugins.value()) {
-			//  Root node should always be empty
-			for (const auto &node : plugin->deviceRootNode().children()) {
-				lvl1nodes.appendChild(node);
-				traverse(node, "/", &dbusRootNode);
+			trees.push_back(std::async(std::launch::async, [plugin] {
+				auto start = std::chrono::steady_clock::now();
+				auto root = plugin->deviceRootNode();
+				return std::pair{std::move(root), elapsedSince(start)};
+			}));
+		}
+		for (size_t i = 0; i < trees.size(); i++) {
+			auto [pluginRoot, duration] = trees[i].get();
+			auto &plugin = *plugins.value()[i];
+			auto pluginFile = boost::dll::symbol_location(plugin).filename().string();
+			qDebug() << "plugin" << QString::fromStdString(pluginFile)
+				 << "built device tree in" << duration.count() << "ms";
 
-				TreeNode<DeviceNode>::preorder(node,
-				    [](auto val) { qDebug() << QString::fromStdString(val.name); });
-			}
+			//  Root node should always be empty
+			for (const auto &node : pluginRoot.children())
+				TreeNode<DeviceNode>::preorder(node, [](const auto &val) {
+					qDebug() << QString::fromStdString(val.name);
+				});
+			pluginRoots.push_back(std::move(pluginRoot));
 		}
 	}
-	auto ma = new MainAdaptor(&root, dbusRootNode);
+	if (!probeCachePath.empty()) {
+		auto stats = ProbeCache::statistics();
+		qDebug() << "probe cache:" << stats.hits << "hits," << stats.misses << "misses";
+		std::error_code ec;
+		std::filesystem::create_directories(
+		    std::filesystem::path{probeCachePath}.parent_path(), ec);
+		if (stats.misses > 0 && !ProbeCache::save(probeCachePath))
+			qDebug() << "Couldn't save probe cache to"
+				 << QString::fromStdString(probeCachePath);
+	}
+	// Measured after all plugins have built their trees, so their allocations aren't counted
+	auto registrationStart = std::chrono::steady_clock::now();
+	auto heapBefore = heapInUse();
+	for (size_t i = 0; i < pluginRoots.size(); i++)
+		registry->addPlugin(plugins.value()[i], std::move(pluginRoots[i]));
+	// Hotplugged readables and devices can't grow the Sampler's arrays once it's running
+	readables.reserve(readables.size() + parser.value(hotplugOption).toUInt(),
+	    readables.deviceCount() + hotplugDevices);
+	// Also starts watching for devices, which are updated from the event loop
+	registry->start();
+	// Heap used for serving the device nodes on the bus
+	auto treeHeapUse = heapInUse() - heapBefore;
+	qDebug() << "registered" << deviceTree->nodeCount() << "nodes in"
+		 << elapsedSince(registrationStart).count() << "ms, using" << treeHeapUse / 1024
+		 << "KiB of heap";
+	// Deleted by root after the sampler has stopped
+	auto subscriptions = new Subscriptions(connection, readables, sampler, &root);
+	auto telemetry = new Telemetry(connection, readables, sampler,
+	    parser.value(ringSizeOption).toUInt(), parser.value(ringGroupOption), &root);
+	auto connections = new Connections(connection, readables, sampler, *deviceTree, &root);
+	auto history = new History(readables, sampler, *historyTiers, &root);
+	MetricsExporter *metricsExporter = nullptr;
+	if (parser.isSet(metricsSocketOption) || parser.isSet(metricsPortOption)) {
+		metricsExporter = new MetricsExporter(readables, sampler, *deviceTree, &root);
+		auto socketPath = parser.value(metricsSocketOption);
+		if (!socketPath.isEmpty() && !metricsExporter->listenLocal(socketPath))
+			qWarning() << "couldn't listen for metrics on" << socketPath;
+		if (parser.isSet(metricsPortOption) && !metricsExporter->listenTcp(metricsPort))
+			qWarning() << "couldn't listen for metrics on port" << metricsPort;
+	}
+	sampler.start();
+	// Scrapes expect all values
+	auto sampleAll = parser.isSet(sampleAllOption) || metricsExporter;
+	if (sampleAll) {
+		std::vector<int> indices(readables.size());
+		std::iota(indices.begin(), indices.end(), 0);
+		sampler.pin(indices, sampler.defaultInterval());
+	}
+	registry->addListener([&, sampleAll, metricsExporter](auto &change) {
+		if (metricsExporter)
+			metricsExporter->addSeries();
+		// Readables added again are still pinned
+		std::vector<int> indices;
+		for (auto index : change.addedReadables) {
+			if (sampleAll && index >= change.previousSize)
+				indices.push_back(index);
+		}
+		sampler.pin(indices, sampler.defaultInterval());
+	});
+	auto ma = new MainAdaptor(&root, connection, *registry, readables, sampler, *deviceTree,
+	    *subscriptions, *telemetry, *connections, *history);
 	connection.registerObject("/", &root);
 
 	if (!connection.registerService("org.tuxclocker")) {
 		qDebug() << "unable to register:" << connection.lastError().message();
 		qDebug() << "errcode" << connection.lastError().type();
 	}
+	qDebug() << "started in" << elapsedSince(startupStart).count() << "ms";
 
 	return a.exec();
 }